@@ -831,10 +831,13 @@ ImageWriterJPEG::ImageWriterJPEG()
 ,	m_DestinationManager(NULL)
 ,	m_QuantTables(NULL)
 {
+	// Lets the destructor tell whether the compress object exists.
+	memset(&m_JPEGCompress, 0, sizeof(m_JPEGCompress));
 }
 
 ImageWriterJPEG::~ImageWriterJPEG()
 {
+	jpeg_destroy_compress(&m_JPEGCompress);
 	delete m_DestinationManager;
 	m_DestinationManager = NULL;
 	delete m_QuantTables;
@@ -892,6 +895,7 @@ void ImageWriterJPEG::setCopyMetaData(bool copyMetaData)
 
 bool ImageWriterJPEG::beginWrite(unsigned int width, unsigned int height, EImageColorModel colorModel)
 {
+	m_WriteError = false;
 	if( setjmp(m_JPEGError.jmp) ) {
 		fprintf(stderr, "error during jpeg compress init: %s", s_JPEGLastError);
 		jpeg_destroy_compress(&m_JPEGCompress);
@@ -1186,8 +1190,8 @@ bool ImageWriterJPEG::endWrite()
 		return false;
 	}
 
+	// The compress object goes back to its idle state, so that another image can be written, and is destroyed with the writer.
 	jpeg_finish_compress(&m_JPEGCompress);
-	jpeg_destroy_compress(&m_JPEGCompress);
 
 	if( m_WriteError ) {
 		return false;
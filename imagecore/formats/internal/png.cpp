@@ -297,13 +297,17 @@ bool ImageWriterPNG::Factory::supportsInputColorModel(EImageColorModel colorMode
 }
 
 ImageWriterPNG::ImageWriterPNG()
-:	m_SourceReader(NULL)
+:	m_PNGCompress(NULL)
+,	m_PNGInfo(NULL)
+,	m_Output(NULL)
+,	m_SourceReader(NULL)
 ,   m_WriteOptions(0)
 {
 }
 
 ImageWriterPNG::~ImageWriterPNG()
 {
+	png_destroy_write_struct(&m_PNGCompress, &m_PNGInfo);
 }
 
 static void png_write_data(png_structp png_ptr, png_bytep data, png_size_t length)
@@ -319,13 +323,20 @@ static void png_flush(png_structp png_ptr)
 }
 
 bool ImageWriterPNG::initWithStorage(ImageWriter::Storage* output)
+{
+	m_Output = output;
+	return createWriteStruct();
+}
+
+// libpng write structs can't be reused once an image is complete, endWrite() destroys it and the next beginWrite() creates a new one.
+bool ImageWriterPNG::createWriteStruct()
 {
 	m_PNGCompress = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	m_PNGInfo = png_create_info_struct(m_PNGCompress);
 	if( setjmp(png_jmpbuf(m_PNGCompress)) ) {
 		return false;
 	}
-	png_set_write_fn(m_PNGCompress, output, png_write_data, png_flush);
+	png_set_write_fn(m_PNGCompress, m_Output, png_write_data, png_flush);
 	return true;
 }
 
@@ -439,6 +450,9 @@ bool ImageWriterPNG::copyLossless(ImageReader* reader)
 
 bool ImageWriterPNG::beginWrite(unsigned int width, unsigned int height, EImageColorModel colorModel)
 {
+	if( m_PNGCompress == NULL && !createWriteStruct() ) {
+		return false;
+	}
 	if( setjmp(png_jmpbuf(m_PNGCompress)) ) {
 		return false;
 	}
@@ -77,10 +77,12 @@ public:
 	virtual bool copyLossless(ImageReader* reader);
 private:
 	virtual bool initWithStorage(Storage* output);
+	bool createWriteStruct();
 	void applyCompressionSettings();
 
 	png_structp m_PNGCompress;
 	png_infop m_PNGInfo;
+	Storage* m_Output;
 	ImageReader* m_SourceReader;
 	unsigned int m_WriteOptions;
 };
@@ -134,6 +134,7 @@ public:
 	virtual bool writeImage(Image* sourceImage) = 0;
 
 	// Incremental writing.
+	// JPEG and PNG writers can write another image to their storage once endWrite() succeeded.
 	virtual bool beginWrite(unsigned int width, unsigned int height, EImageColorModel colorModel) = 0;
 	virtual unsigned int writeRows(Image* sourceImage, unsigned int sourceRow, unsigned int numRows) = 0;
 	virtual bool endWrite() = 0;
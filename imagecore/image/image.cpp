@@ -22,6 +22,8 @@
  * SOFTWARE.
  */
 
+#include <atomic>
+
 #include "imagecore/imagecore.h"
 #include "imagecore/utils/mathutils.h"
 #include "imagecore/utils/securemath.h"
@@ -29,6 +31,7 @@
 #include "imagecore/image/rgba.h"
 #include "imagecore/image/grayscale.h"
 #include "imagecore/image/yuv.h"
+#include "internal/executor.h"
 #include "internal/filters.h"
 
 namespace imagecore {
@@ -347,7 +350,10 @@ IMAGEPLANE(void)::fillPadding(EEdgeMask edgeMask)
 
 IMAGEPLANE(void)::reduceHalf(ImagePlane<Channels>* dest)
 {
-	dest->setDimensions(m_Width / 2, m_Height / 2);
+	// Keep the pitch of a destination that is already sized, e.g. a cropped region of a larger plane.
+	if( dest->getWidth() != m_Width / 2 || dest->getHeight() != m_Height / 2 ) {
+		dest->setDimensions(m_Width / 2, m_Height / 2);
+	}
 	unsigned int destPitch = 0;
 	uint8_t* destBuffer = dest->lockRect(m_Width / 2, m_Height / 2, destPitch);
 	Filters<ComponentSIMD<Channels>>::reduceHalf(this->getBytes(), destBuffer, m_Width, m_Height, m_Pitch, destPitch, dest->getImageSize());
@@ -378,88 +384,150 @@ IMAGEPLANE(bool)::resize(ImagePlane<Channels>* dest, EResizeQuality quality)
 		delete workBuffer;
 		return success;
 	} else {
-		// Downsample.
-		ImagePlane<Channels>* whichImage = this;
-		EFilterType kernelType = Image::getDownsampleFilterKernelType(quality);
-		unsigned int kernelSize = Image::getDownsampleFilterKernelSize(quality);
-
-		unsigned int destWidth = dest->getWidth();
-		unsigned int destHeight = dest->getHeight();
-		ImagePlane<Channels>* workBuffer[2] = { NULL, NULL };
-		bool unpadded = false;
-		bool doneDownsampling = false;
-		if(Filters<ComponentSIMD<Channels>>::supportsUnpadded(kernelSize)) {
-			unpadded = Filters<ComponentSIMD<Channels>>::fasterUnpadded(kernelSize);
+		return downsample(dest, quality, kImageOrientation_Up);
+	}
+}
+
+IMAGEPLANE(bool)::resize(ImagePlane<Channels>* dest, EResizeQuality quality, EImageOrientation orientation)
+{
+	if( orientation == kImageOrientation_Up ) {
+		return resize(dest, quality);
+	}
+	bool transposed = orientation == kImageOrientation_Left || orientation == kImageOrientation_Right;
+	unsigned int scaledWidth = transposed ? dest->getHeight() : dest->getWidth();
+	unsigned int scaledHeight = transposed ? dest->getWidth() : dest->getHeight();
+	if( scaledWidth == m_Width && scaledHeight == m_Height ) {
+		rotate(dest, orientation);
+		return true;
+	} else if( transposed && scaledWidth <= m_Width && scaledHeight <= m_Height && Image::getDownsampleFilterKernelSize(quality) != 4 ) {
+		return downsample(dest, quality, orientation);
+	}
+	// Upsampling, Low quality and Down go through a scaled copy.
+	ImagePlane<Channels>* scaled = ImagePlane<Channels>::create(scaledWidth, scaledHeight, 0, 16U);
+	if( scaled == NULL ) {
+		return false;
+	}
+	bool success = resize(scaled, quality);
+	if( success ) {
+		scaled->rotate(dest, orientation);
+	}
+	delete scaled;
+	return success;
+}
+
+IMAGEPLANE(bool)::downsample(ImagePlane<Channels>* dest, EResizeQuality quality, EImageOrientation orientation)
+{
+	ImagePlane<Channels>* whichImage = this;
+	EFilterType kernelType = Image::getDownsampleFilterKernelType(quality);
+	unsigned int kernelSize = Image::getDownsampleFilterKernelSize(quality);
+
+	// Size before rotation.
+	bool transposed = orientation == kImageOrientation_Left || orientation == kImageOrientation_Right;
+	unsigned int destWidth = transposed ? dest->getHeight() : dest->getWidth();
+	unsigned int destHeight = transposed ? dest->getWidth() : dest->getHeight();
+	ImagePlane<Channels>* workBuffer[2] = { NULL, NULL };
+	bool unpadded = false;
+	bool doneDownsampling = false;
+	if(Filters<ComponentSIMD<Channels>>::supportsUnpadded(kernelSize)) {
+		unpadded = Filters<ComponentSIMD<Channels>>::fasterUnpadded(kernelSize);
+	}
+	// Do we need to do iterative 2x2 reductions first?
+	if (whichImage->getWidth() / 2 >= destWidth && whichImage->getHeight() / 2 >= destHeight) {
+		workBuffer[0] = ImagePlane<Channels>::create(whichImage->getWidth() / 2, whichImage->getHeight() / 2, kernelSize, 16);
+		workBuffer[1] = ImagePlane<Channels>::create(whichImage->getWidth() / 2, whichImage->getHeight() / 2, kernelSize, 16);
+
+		if (workBuffer[0] == NULL || workBuffer[1] == NULL) {
+			delete workBuffer[0];
+			delete workBuffer[1];
+			return false;
 		}
-		// Do we need to do iterative 2x2 reductions first?
-		if (whichImage->getWidth() / 2 >= destWidth && whichImage->getHeight() / 2 >= destHeight) {
-			workBuffer[0] = ImagePlane<Channels>::create(whichImage->getWidth() / 2, whichImage->getHeight() / 2, kernelSize, 16);
-			workBuffer[1] = ImagePlane<Channels>::create(whichImage->getWidth() / 2, whichImage->getHeight() / 2, kernelSize, 16);
-
-			if (workBuffer[0] == NULL || workBuffer[1] == NULL) {
-				delete workBuffer[0];
-				delete workBuffer[1];
-				return false;
-			}
 
-			unsigned int whichWorkBuffer = 0;
-			while (!doneDownsampling && whichImage->getWidth() / 2 >= destWidth && whichImage->getHeight() / 2 >= destHeight) {
-				if ((whichImage->getWidth() / 2 == destWidth) && (whichImage->getHeight() / 2 == destHeight)) {
+		unsigned int whichWorkBuffer = 0;
+		while (!doneDownsampling && whichImage->getWidth() / 2 >= destWidth && whichImage->getHeight() / 2 >= destHeight) {
+			if ((whichImage->getWidth() / 2 == destWidth) && (whichImage->getHeight() / 2 == destHeight)) {
+				if (orientation == kImageOrientation_Up) {
 					whichImage->reduceHalf(dest);
-					doneDownsampling = true; // for the case where reducehalf gets us the correct size
 				} else {
+					// Nothing left to fold the rotation into.
 					whichImage->reduceHalf(workBuffer[whichWorkBuffer]);
-					whichImage = workBuffer[whichWorkBuffer];
-					whichWorkBuffer ^= 1;
+					workBuffer[whichWorkBuffer]->rotate(dest, orientation);
 				}
-			}
-		} else if (m_Padding < kernelSize) {
-			if(Filters<ComponentSIMD<Channels>>::supportsUnpadded(kernelSize)) {
-				unpadded = true; // use unpadded code path to avoid copying for all bit depths
+				doneDownsampling = true; // for the case where reducehalf gets us the correct size
 			} else {
-				// TODO: this is wasteful, find another solution
-				workBuffer[0] = ImagePlane<Channels>::create(whichImage->getWidth(), whichImage->getHeight(), kernelSize, 16);
-				if (workBuffer[0] == NULL) {
-					return false;
-				}
-				copy(workBuffer[0]);
-				whichImage = workBuffer[0];
+				whichImage->reduceHalf(workBuffer[whichWorkBuffer]);
+				whichImage = workBuffer[whichWorkBuffer];
+				whichWorkBuffer ^= 1;
 			}
 		}
-
-		bool success = false;
-		if (doneDownsampling) {
-			success = true;
+	} else if (m_Padding < kernelSize) {
+		if(Filters<ComponentSIMD<Channels>>::supportsUnpadded(kernelSize)) {
+			unpadded = true; // use unpadded code path to avoid copying for all bit depths
 		} else {
-			FilterKernelAdaptive filterKernelX(kernelType, kernelSize, whichImage->getWidth(), destWidth);
-			FilterKernelAdaptive filterKernelY(kernelType, kernelSize, whichImage->getHeight(), destHeight);
-			success = whichImage->downsampleFilter(dest, &filterKernelX, &filterKernelY, unpadded);
+			// TODO: this is wasteful, find another solution
+			workBuffer[0] = ImagePlane<Channels>::create(whichImage->getWidth(), whichImage->getHeight(), kernelSize, 16);
+			if (workBuffer[0] == NULL) {
+				return false;
+			}
+			copy(workBuffer[0]);
+			whichImage = workBuffer[0];
 		}
-		// Only allocated if iterative reduction was performed.
-		delete workBuffer[0];
-		delete workBuffer[1];
-		return success;
 	}
+
+	bool success = false;
+	if (doneDownsampling) {
+		success = true;
+	} else {
+		FilterKernelAdaptive filterKernelX(kernelType, kernelSize, whichImage->getWidth(), destWidth);
+		FilterKernelAdaptive filterKernelY(kernelType, kernelSize, whichImage->getHeight(), destHeight);
+		success = whichImage->downsampleFilter(dest, &filterKernelX, &filterKernelY, unpadded, orientation);
+	}
+	// Only allocated if iterative reduction was performed.
+	delete workBuffer[0];
+	delete workBuffer[1];
+	return success;
 }
 
-IMAGEPLANE(bool)::downsampleFilter(ImagePlane<Channels> *dest, const FilterKernelAdaptive *filterKernelX, const FilterKernelAdaptive *filterKernelY, bool unpadded)
+IMAGEPLANE(bool)::downsampleFilter(ImagePlane<Channels> *dest, const FilterKernelAdaptive *filterKernelX, const FilterKernelAdaptive *filterKernelY, bool unpadded, EImageOrientation orientation)
 {
+	// Only the filters that write transposed can fold in a rotation.
+	SECURE_ASSERT(orientation == kImageOrientation_Up || ((orientation == kImageOrientation_Left || orientation == kImageOrientation_Right) && filterKernelX->getKernelSize() != 4));
 	if (filterKernelX->getKernelSize() == 2) {
 		// Special low quality but fast 2x2 bilinear filter, used for on device video transcoding
-		return downsampleFilter2x2(dest, filterKernelX, filterKernelY);
+		return downsampleFilter2x2(dest, filterKernelX, filterKernelY, orientation);
 	} else if (filterKernelX->getKernelSize() == 4) {
 		// Special 4x4 non-seperable filter.
 		return downsampleFilter4x4(dest, filterKernelX, filterKernelY);
 	} else {
-		return downsampleFilterSeperable(dest, filterKernelX, filterKernelY, unpadded);
+		return downsampleFilterSeperable(dest, filterKernelX, filterKernelY, unpadded, orientation);
 	}
 }
 
-IMAGEPLANE(bool)::downsampleFilterSeperable(ImagePlane<Channels>* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY, bool unpadded)
+// The seperable version writes transposed images, so every input row (the axis that isn't filtered) becomes
+// an output column. Bands of input rows write disjoint columns and need no kernel sample offsets.
+template<uint32_t Channels>
+static void adaptiveSeperableBands(const FilterKernelAdaptive* kernel, const uint8_t* inputBuffer, unsigned int inputWidth, unsigned int inputHeight, unsigned int inputPitch,
+								   uint8_t* outputBuffer, unsigned int outputWidth, unsigned int outputHeight, unsigned int outputPitch, unsigned int outputCapacity, bool unpadded)
+{
+	// The filters check outputWidth rows of outputPitch against the capacity, which holds for every band
+	// as long as all the columns fit in a row.
+	SECURE_ASSERT(SafeUMul(outputHeight, Channels) <= outputPitch);
+	Executor::runBands(outputHeight, [=](unsigned int startRow, unsigned int endRow) {
+		Filters<ComponentSIMD<Channels>>::adaptiveSeperable(kernel, inputBuffer + SafeUMul(startRow, inputPitch), inputWidth, endRow - startRow, inputPitch,
+															 outputBuffer + SafeUMul(startRow, Channels), outputWidth, endRow - startRow, outputPitch, outputCapacity, unpadded);
+	});
+}
+
+// Columns of the scaled image filtered and rotated at a time when a rotation is folded into the second pass.
+const unsigned int kRotateStripColumns = 64;
+
+IMAGEPLANE(bool)::downsampleFilterSeperable(ImagePlane<Channels>* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY, bool unpadded, EImageOrientation orientation)
 {
+	bool transposed = orientation == kImageOrientation_Left || orientation == kImageOrientation_Right;
+	unsigned int destWidth = transposed ? dest->getHeight() : dest->getWidth();
+	unsigned int destHeight = transposed ? dest->getWidth() : dest->getHeight();
 	unsigned int padSize = max(filterKernelX->getKernelSize(), filterKernelY->getKernelSize());
 	SECURE_ASSERT((m_Padding >= padSize) || (unpadded));
-	ImagePlane<Channels>* temp = ImagePlane<Channels>::create(m_Height, dest->getWidth(), padSize, 16U);
+	ImagePlane<Channels>* temp = ImagePlane<Channels>::create(m_Height, destWidth, padSize, 16U);
 	if( temp == NULL ) {
 		return false;
 	}
@@ -468,32 +536,85 @@ IMAGEPLANE(bool)::downsampleFilterSeperable(ImagePlane<Channels>* dest, const Fi
 		fillPadding();
 	}
 	uint8_t* tempBuffer = temp->lockRect(temp->getWidth(), temp->getHeight(), tempPitch);
-	Filters<ComponentSIMD<Channels>>::adaptiveSeperable(filterKernelX, this->getBytes(), m_Width, m_Height, m_Pitch,
-							   tempBuffer, temp->getHeight(), temp->getWidth(), tempPitch, temp->getImageSize(), unpadded);
+	adaptiveSeperableBands<Channels>(filterKernelX, this->getBytes(), m_Width, m_Height, m_Pitch,
+										 tempBuffer, temp->getHeight(), temp->getWidth(), tempPitch, temp->getImageSize(), unpadded);
 	temp->unlockRect();
 	if( !unpadded ) {
 		temp->fillPadding();
 	}
 	unsigned int destPitch = 0;
 	uint8_t* destBuffer = dest->lockRect(dest->getWidth(), dest->getHeight(), destPitch);
-	Filters<ComponentSIMD<Channels>>::adaptiveSeperable(filterKernelY, temp->getBytes(), temp->getWidth(), temp->getHeight(), temp->getPitch(),
-							   destBuffer, dest->getHeight(), dest->getWidth(), destPitch, dest->getImageSize(), unpadded);
+	bool success = true;
+	if( !transposed ) {
+		adaptiveSeperableBands<Channels>(filterKernelY, temp->getBytes(), temp->getWidth(), temp->getHeight(), temp->getPitch(),
+											 destBuffer, dest->getHeight(), dest->getWidth(), destPitch, dest->getImageSize(), unpadded);
+	} else {
+		// Every temp row is a column of the scaled image. The second pass filters them a strip at a time, and each strip
+		// is rotated into its destination rows while it is still in cache, instead of going through a scaled copy of the plane.
+		const uint8_t* tempBytes = temp->getBytes();
+		unsigned int tempWidth = temp->getWidth();
+		tempPitch = temp->getPitch();
+		std::atomic<bool> allocated(true);
+		Executor::runBands(destWidth, [&](unsigned int startColumn, unsigned int endColumn) {
+			ImagePlane<Channels>* strip = ImagePlane<Channels>::create(kRotateStripColumns, destHeight, 0, 16U);
+			if( strip == NULL ) {
+				allocated = false;
+				return;
+			}
+			unsigned int stripPitch = 0;
+			uint8_t* stripBuffer = strip->lockRect(kRotateStripColumns, destHeight, stripPitch);
+			for( unsigned int column = startColumn; column < endColumn; column += kRotateStripColumns ) {
+				unsigned int columns = min(kRotateStripColumns, endColumn - column);
+				Filters<ComponentSIMD<Channels>>::adaptiveSeperable(filterKernelY, tempBytes + SafeUMul(column, tempPitch), tempWidth, columns, tempPitch,
+																	 stripBuffer, destHeight, columns, stripPitch, strip->getImageSize(), unpadded);
+				// Right turns scaled column x into destination row x, Left into row destWidth - 1 - x.
+				unsigned int destRow = orientation == kImageOrientation_Right ? column : destWidth - column - columns;
+				uint8_t* destRows = destBuffer + SafeUMul(destRow, destPitch);
+				if( orientation == kImageOrientation_Right ) {
+					Filters<ComponentSIMD<Channels>>::rotateRight(stripBuffer, destRows, columns, destHeight, stripPitch, destPitch, SafeUMul(columns, destPitch));
+				} else {
+					Filters<ComponentSIMD<Channels>>::rotateLeft(stripBuffer, destRows, columns, destHeight, stripPitch, destPitch, SafeUMul(columns, destPitch));
+				}
+			}
+			strip->unlockRect();
+			delete strip;
+		});
+		success = allocated;
+	}
 	dest->unlockRect();
 	delete temp;
-	return true;
+	return success;
 }
 
 
-IMAGEPLANE(bool)::downsampleFilter2x2(ImagePlane<Channels>* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY)
+IMAGEPLANE(bool)::downsampleFilter2x2(ImagePlane<Channels>* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY, EImageOrientation orientation)
 {
+	bool transposed = orientation == kImageOrientation_Left || orientation == kImageOrientation_Right;
+	unsigned int destWidth = transposed ? dest->getHeight() : dest->getWidth();
+	unsigned int destHeight = transposed ? dest->getWidth() : dest->getHeight();
 	unsigned int destPitch = 0;
 	fillPadding();
-	ImagePlane<Channels>* transposedDest = ImagePlane<Channels>::create(dest->getHeight(), dest->getWidth(), 0, 4);
-	uint8_t* destBuffer = transposedDest->lockRect(dest->getHeight(), dest->getWidth(), destPitch);
+	ImagePlane<Channels>* transposedDest = ImagePlane<Channels>::create(destHeight, destWidth, 0, 4);
+	uint8_t* destBuffer = transposedDest->lockRect(destHeight, destWidth, destPitch);
 	Filters<ComponentSIMD<Channels>>::adaptiveSeparable2x2(filterKernelX, filterKernelY, this->getBytes(), m_Width, m_Height, m_Pitch,
-												  destBuffer, dest->getWidth(), dest->getHeight(), destPitch, dest->getImageSize());
+												  destBuffer, destWidth, destHeight, destPitch, transposedDest->getImageSize());
 	transposedDest->unlockRect();
-	transposedDest->transpose(dest);
+	if( !transposed ) {
+		transposedDest->transpose(dest);
+	} else {
+		// The transposed result only needs flipping, in place of the transpose: vertically to turn Left, horizontally to turn Right.
+		unsigned int rotatedPitch = 0;
+		uint8_t* rotatedBuffer = dest->lockRect(dest->getWidth(), dest->getHeight(), rotatedPitch);
+		for( unsigned int y = 0; y < destWidth; y++ ) {
+			uint8_t* rotatedRow = rotatedBuffer + SafeUMul(y, rotatedPitch);
+			if( orientation == kImageOrientation_Left ) {
+				memcpy(rotatedRow, destBuffer + SafeUMul(destWidth - 1 - y, destPitch), SafeUMul(destHeight, Channels));
+			} else {
+				Filters<ComponentSIMD<Channels>>::rotateUp(destBuffer + SafeUMul(y, destPitch), rotatedRow, destHeight, 1, destPitch, rotatedPitch, rotatedPitch);
+			}
+		}
+		dest->unlockRect();
+	}
 	delete transposedDest;
 	return true;
 }
@@ -559,6 +680,12 @@ IMAGEPLANE(void)::copy(ImagePlane<Channels>* dest)
 	copyRect(dest, 0, 0, 0, 0, m_Width, m_Height);
 }
 
+IMAGEPLANE(uint64_t)::sumAbsoluteDifferences(ImagePlane<Channels>* other)
+{
+	SECURE_ASSERT(other->getWidth() == m_Width && other->getHeight() == m_Height);
+	return Filters<ComponentSIMD<Channels>>::sumAbsoluteDifferences(getBytes(), other->getBytes(), m_Width, m_Height, m_Pitch, other->getPitch());
+}
+
 template class ImagePlane<1>;
 template class ImagePlane<2>;
 template class ImagePlane<4>;
@@ -257,8 +257,11 @@ public:
 	void setOffset(unsigned int offsetX, unsigned int offsetY);
 
 	bool resize(ImagePlane* dest, EResizeQuality quality);
+	// Resizes and rotates as rotate() does into dest, which is already sized for the rotated result; kImageOrientation_Up only resizes.
+	// Left and Right are folded into the last pass of a Bilinear, Medium or High downsample instead of going through a scaled copy.
+	bool resize(ImagePlane* dest, EResizeQuality quality, EImageOrientation orientation);
 	void reduceHalf(ImagePlane* dest);
-	bool downsampleFilter(ImagePlane* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY, bool unpadded);
+	bool downsampleFilter(ImagePlane* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY, bool unpadded, EImageOrientation orientation = kImageOrientation_Up);
 	bool crop(const ImageRegion& boundingBox);
 	void rotate(ImagePlane* dest, EImageOrientation direction);
 	void transpose(ImagePlane* dest);
@@ -268,6 +271,7 @@ public:
 	void clearRect(unsigned int x, unsigned int y, unsigned int w, unsigned int h, typename primType::asType component);
 	void copyRect(ImagePlane* dest, unsigned int sourceX, unsigned int sourceY, unsigned int destX, unsigned int destY, unsigned int width, unsigned int height);
 	void copy(ImagePlane* dest);
+	uint64_t sumAbsoluteDifferences(ImagePlane* other);
 
 	unsigned int getWidth()
 	{
@@ -304,9 +308,10 @@ public:
 private:
 	ImagePlane(uint8_t* buffer, unsigned int capacity, bool ownsBuffer);
 	bool checkCapacity(unsigned int width, unsigned int height);
-	bool downsampleFilterSeperable(ImagePlane* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY, bool unpadded);
+	bool downsample(ImagePlane* dest, EResizeQuality quality, EImageOrientation orientation);
+	bool downsampleFilterSeperable(ImagePlane* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY, bool unpadded, EImageOrientation orientation);
 	bool downsampleFilter4x4(ImagePlane* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY);
-	bool downsampleFilter2x2(ImagePlane* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY);
+	bool downsampleFilter2x2(ImagePlane* dest, const FilterKernelAdaptive* filterKernelX, const FilterKernelAdaptive* filterKernelY, EImageOrientation orientation);
 	bool upsampleFilter4x4(ImagePlane* dest, const FilterKernelFixed* filterKernelX, const FilterKernelFixed* filterKernelY);
 
 	static unsigned int paddingOffset(unsigned int pitch, unsigned int pad_amount);
@@ -0,0 +1,277 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "filters.h"
+#include "imagecore/imagecore.h"
+#include "imagecore/utils/securemath.h"
+#include "imagecore/utils/mathutils.h"
+
+#if __SSE4_1__
+
+#include <immintrin.h>
+#include "intrinsics.h"
+
+// Only these functions are built for AVX2, the dispatch in sse.cpp makes sure they run on CPUs that have it.
+#define IMAGECORE_AVX2 __attribute__((target("avx2")))
+
+namespace imagecore {
+
+// Adds the two 128 bit lanes.
+static inline IMAGECORE_AVX2 __m128i foldLanes(__m256i a)
+{
+	return _mm_add_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+}
+
+// Shifts 16.16 fixed point sums back to 8 bits, saturating, in the low 4 bytes.
+static inline IMAGECORE_AVX2 int32_t pack4(__m128i sum)
+{
+	__m128i zero = _mm_setzero_si128();
+	sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(kHalf16)), 16);
+	return _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packus_epi32(sum, zero), zero));
+}
+
+// Adaptive-width filter, single axis, 4 channels, KernelSize samples.
+// Two samples are filtered per 256 bit vector: the kernel table repeats every coefficient 4 times,
+// so samples k and k + 1 line up with 8 consecutive table entries.
+template<unsigned int KernelSize>
+static IMAGECORE_AVX2 void adaptiveSeperable4(const FilterKernelAdaptive* kernel, const uint8_t* __restrict inputBuffer, unsigned int inputPitch, uint8_t* __restrict outputBuffer, unsigned int outputWidth, unsigned int outputHeight, unsigned int outputPitch)
+{
+	const unsigned int pairs = KernelSize / 2;
+	const int32_t* kernelTable = kernel->getTableFixedPoint4();
+	for( unsigned int x = 0; x < outputWidth; x++ ) {
+		__m256i coeffs[pairs];
+		for( unsigned int pair = 0; pair < pairs; pair++ ) {
+			coeffs[pair] = _mm256_loadu_si256((const __m256i*)(kernelTable + x * KernelSize * 4 + pair * 8));
+		}
+		const uint8_t* sample = inputBuffer + kernel->computeSampleStart(x) * 4;
+		uint8_t* outputSample = outputBuffer + (x * outputPitch);
+		for( unsigned int y = 0; y < outputHeight; y++ ) {
+			__m256i sum = _mm256_setzero_si256();
+			for( unsigned int pair = 0; pair < pairs; pair++ ) {
+				__m256i samples = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(sample + pair * 8)));
+				sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(samples, coeffs[pair]));
+			}
+			*(int32_t*)outputSample = pack4(foldLanes(sum));
+			outputSample += 4;
+			sample += inputPitch;
+		}
+	}
+}
+
+// Adaptive-width filter, single axis, 4 channels, any number of samples.
+static IMAGECORE_AVX2 void adaptiveSeperable4Any(const FilterKernelAdaptive* kernel, const uint8_t* __restrict inputBuffer, unsigned int inputPitch, uint8_t* __restrict outputBuffer, unsigned int outputWidth, unsigned int outputHeight, unsigned int outputPitch)
+{
+	unsigned int kernelSize = kernel->getKernelSize();
+	const int32_t* kernelTable = kernel->getTableFixedPoint4();
+	for( unsigned int x = 0; x < outputWidth; x++ ) {
+		const int32_t* coeffs = kernelTable + x * kernelSize * 4;
+		const uint8_t* sample = inputBuffer + kernel->computeSampleStart(x) * 4;
+		uint8_t* outputSample = outputBuffer + (x * outputPitch);
+		for( unsigned int y = 0; y < outputHeight; y++ ) {
+			__m256i sum = _mm256_setzero_si256();
+			unsigned int k = 0;
+			for( ; k + 2 <= kernelSize; k += 2 ) {
+				__m256i samples = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(sample + k * 4)));
+				sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(samples, _mm256_loadu_si256((const __m256i*)(coeffs + k * 4))));
+			}
+			__m128i total = foldLanes(sum);
+			if( k < kernelSize ) {
+				__m128i last = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*(const int32_t*)(sample + k * 4)));
+				total = _mm_add_epi32(total, _mm_mullo_epi32(last, _mm_loadu_si128((const __m128i*)(coeffs + k * 4))));
+			}
+			*(int32_t*)outputSample = pack4(total);
+			outputSample += 4;
+			sample += inputPitch;
+		}
+	}
+}
+
+// Adaptive-width filter, single axis, 4 channels, 12 samples, for unpadded images.
+// Sample positions are clamped to the image, only the first Pairs * 2 samples (at least getMaxSamples()) are read.
+template<unsigned int Pairs>
+static IMAGECORE_AVX2 void adaptiveSeperable4Unpadded12(const FilterKernelAdaptive* kernel, const uint8_t* __restrict inputBuffer, unsigned int inputWidth, unsigned int inputPitch, uint8_t* __restrict outputBuffer, unsigned int outputWidth, unsigned int outputHeight, unsigned int outputPitch)
+{
+	const int32_t* kernelTable = kernel->getTableFixedPoint4();
+	for( unsigned int x = 0; x < outputWidth; x++ ) {
+		int startX = kernel->computeSampleStart(x);
+		int32_t offsets[Pairs * 2];
+		for( unsigned int k = 0; k < Pairs * 2; k++ ) {
+			offsets[k] = clamp(0, (int32_t)inputWidth - 1, startX + (int32_t)k) * 4;
+		}
+		__m256i coeffs[Pairs];
+		for( unsigned int pair = 0; pair < Pairs; pair++ ) {
+			coeffs[pair] = _mm256_loadu_si256((const __m256i*)(kernelTable + x * 48 + pair * 8));
+		}
+		const uint8_t* row = inputBuffer;
+		uint8_t* outputSample = outputBuffer + (x * outputPitch);
+		for( unsigned int y = 0; y < outputHeight; y++ ) {
+			__m256i sum = _mm256_setzero_si256();
+			for( unsigned int pair = 0; pair < Pairs; pair++ ) {
+				__m128i first = _mm_cvtsi32_si128(*(const int32_t*)(row + offsets[pair * 2]));
+				__m128i second = _mm_cvtsi32_si128(*(const int32_t*)(row + offsets[pair * 2 + 1]));
+				__m256i samples = _mm256_cvtepu8_epi32(_mm_unpacklo_epi32(first, second));
+				sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(samples, coeffs[pair]));
+			}
+			*(int32_t*)outputSample = pack4(foldLanes(sum));
+			outputSample += 4;
+			row += inputPitch;
+		}
+	}
+}
+
+// Single channel, 12 samples: 8 of them in 256 bits, 4 in 128 bits, summed across the lanes.
+static inline IMAGECORE_AVX2 __m256i filterRow12(__m256i samples0_7, __m128i samples8_11, __m256i coeffs0_7, __m128i coeffs8_11)
+{
+	__m128i tail = _mm_mullo_epi32(samples8_11, coeffs8_11);
+	return _mm256_add_epi32(_mm256_mullo_epi32(samples0_7, coeffs0_7), _mm256_inserti128_si256(_mm256_setzero_si256(), tail, 0));
+}
+
+static inline IMAGECORE_AVX2 __m256i loadRow12(const uint8_t* sample, __m256i coeffs0_7, __m128i coeffs8_11)
+{
+	__m128i bytes = _mm_loadu_si128((const __m128i*)sample);
+	return filterRow12(_mm256_cvtepu8_epi32(bytes), _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8)), coeffs0_7, coeffs8_11);
+}
+
+static inline IMAGECORE_AVX2 uint8_t pack1(__m256i row)
+{
+	__m128i sum = foldLanes(row);
+	sum = _mm_hadd_epi32(sum, sum);
+	sum = _mm_hadd_epi32(sum, sum);
+	return (uint8_t)pack4(sum);
+}
+
+// Horizontal sums of 8 rows, in row order.
+static inline IMAGECORE_AVX2 __m256i sumRows8(__m256i r0, __m256i r1, __m256i r2, __m256i r3, __m256i r4, __m256i r5, __m256i r6, __m256i r7)
+{
+	__m256i r0123 = _mm256_hadd_epi32(_mm256_hadd_epi32(r0, r1), _mm256_hadd_epi32(r2, r3));
+	__m256i r4567 = _mm256_hadd_epi32(_mm256_hadd_epi32(r4, r5), _mm256_hadd_epi32(r6, r7));
+	return _mm256_add_epi32(_mm256_permute2x128_si256(r0123, r4567, 0x20), _mm256_permute2x128_si256(r0123, r4567, 0x31));
+}
+
+// Adaptive-width filter, single axis, single channel, 12 samples, 8 rows at a time.
+// Unpadded images use clamped sample positions for the columns whose 16 byte loads would leave the image.
+static IMAGECORE_AVX2 void adaptiveSeperable1_12(const FilterKernelAdaptive* kernel, const uint8_t* __restrict inputBuffer, unsigned int inputWidth, unsigned int inputPitch, uint8_t* __restrict outputBuffer, unsigned int outputWidth, unsigned int outputHeight, unsigned int outputPitch, bool unpadded)
+{
+	const int32_t* kernelTable = kernel->getTableFixedPoint();
+	__m256i half = _mm256_set1_epi32(kHalf16);
+	for( unsigned int x = 0; x < outputWidth; x++ ) {
+		int startX = kernel->computeSampleStart(x);
+		__m256i coeffs0_7 = _mm256_loadu_si256((const __m256i*)(kernelTable + x * 12));
+		__m128i coeffs8_11 = _mm_loadu_si128((const __m128i*)(kernelTable + x * 12 + 8));
+		uint8_t* outputSample = outputBuffer + (x * outputPitch);
+		if( !unpadded || (startX >= 0 && startX + 16 <= (int)inputWidth) ) {
+			const uint8_t* sample = inputBuffer + startX;
+			unsigned int y = 0;
+			for( ; y + 8 <= outputHeight; y += 8 ) {
+				__m256i sums = sumRows8(loadRow12(sample + inputPitch * 0, coeffs0_7, coeffs8_11),
+										loadRow12(sample + inputPitch * 1, coeffs0_7, coeffs8_11),
+										loadRow12(sample + inputPitch * 2, coeffs0_7, coeffs8_11),
+										loadRow12(sample + inputPitch * 3, coeffs0_7, coeffs8_11),
+										loadRow12(sample + inputPitch * 4, coeffs0_7, coeffs8_11),
+										loadRow12(sample + inputPitch * 5, coeffs0_7, coeffs8_11),
+										loadRow12(sample + inputPitch * 6, coeffs0_7, coeffs8_11),
+										loadRow12(sample + inputPitch * 7, coeffs0_7, coeffs8_11));
+				sums = _mm256_srai_epi32(_mm256_add_epi32(sums, half), 16);
+				__m128i packed16 = _mm_packus_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+				_mm_storel_epi64((__m128i*)outputSample, _mm_packus_epi16(packed16, packed16));
+				outputSample += 8;
+				sample += inputPitch * 8;
+			}
+			for( ; y < outputHeight; y++ ) {
+				*outputSample++ = pack1(loadRow12(sample, coeffs0_7, coeffs8_11));
+				sample += inputPitch;
+			}
+		} else {
+			int32_t offsets[12];
+			for( int k = 0; k < 12; k++ ) {
+				offsets[k] = clamp(0, (int32_t)inputWidth - 1, startX + k);
+			}
+			const uint8_t* row = inputBuffer;
+			for( unsigned int y = 0; y < outputHeight; y++ ) {
+				__m256i samples0_7 = _mm256_setr_epi32(row[offsets[0]], row[offsets[1]], row[offsets[2]], row[offsets[3]], row[offsets[4]], row[offsets[5]], row[offsets[6]], row[offsets[7]]);
+				__m128i samples8_11 = _mm_setr_epi32(row[offsets[8]], row[offsets[9]], row[offsets[10]], row[offsets[11]]);
+				*outputSample++ = pack1(filterRow12(samples0_7, samples8_11, coeffs0_7, coeffs8_11));
+				row += inputPitch;
+			}
+		}
+	}
+}
+
+template<>
+void FiltersAVX2<ComponentSIMD<4>>::adaptiveSeperable(const FilterKernelAdaptive* kernel, const uint8_t* __restrict inputBuffer, unsigned int inputWidth, unsigned int inputHeight, unsigned int inputPitch, uint8_t* __restrict outputBuffer, unsigned int outputWidth, unsigned int outputHeight, unsigned int outputPitch, unsigned int outputCapacity, bool unpadded)
+{
+	// The seperable version writes transposed images.
+	SECURE_ASSERT(SafeUMul(outputHeight, 4U) <= outputPitch);
+	SECURE_ASSERT(SafeUMul(outputWidth, outputPitch) <= outputCapacity);
+	unsigned int kernelSize = kernel->getKernelSize();
+	if( kernelSize == 12U && unpadded ) {
+		switch( ((uint32_t)kernel->getMaxSamples() + 1) / 2 ) {
+			case 6: {
+				adaptiveSeperable4Unpadded12<6>(kernel, inputBuffer, inputWidth, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch);
+				break;
+			}
+			case 5: {
+				adaptiveSeperable4Unpadded12<5>(kernel, inputBuffer, inputWidth, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch);
+				break;
+			}
+			case 4: {
+				adaptiveSeperable4Unpadded12<4>(kernel, inputBuffer, inputWidth, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch);
+				break;
+			}
+			case 3: {
+				adaptiveSeperable4Unpadded12<3>(kernel, inputBuffer, inputWidth, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch);
+				break;
+			}
+			case 2: {
+				adaptiveSeperable4Unpadded12<2>(kernel, inputBuffer, inputWidth, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch);
+				break;
+			}
+			case 1: {
+				adaptiveSeperable4Unpadded12<1>(kernel, inputBuffer, inputWidth, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch);
+				break;
+			}
+		}
+	} else if( kernelSize == 8U ) {
+		adaptiveSeperable4<8>(kernel, inputBuffer, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch);
+	} else if( kernelSize == 12U ) {
+		adaptiveSeperable4<12>(kernel, inputBuffer, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch);
+	} else {
+		adaptiveSeperable4Any(kernel, inputBuffer, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch);
+	}
+}
+
+template<>
+void FiltersAVX2<ComponentSIMD<1>>::adaptiveSeperable(const FilterKernelAdaptive* kernel, const uint8_t* __restrict inputBuffer, unsigned int inputWidth, unsigned int inputHeight, unsigned int inputPitch, uint8_t* __restrict outputBuffer, unsigned int outputWidth, unsigned int outputHeight, unsigned int outputPitch, unsigned int outputCapacity, bool unpadded)
+{
+	// The seperable version writes transposed images.
+	SECURE_ASSERT(SafeUMul(outputHeight, 1U) <= outputPitch);
+	SECURE_ASSERT(SafeUMul(outputWidth, outputPitch) <= outputCapacity);
+	// Same kernel sizes as the SSE version.
+	SECURE_ASSERT(kernel->getKernelSize() == 12U);
+	adaptiveSeperable1_12(kernel, inputBuffer, inputWidth, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch, unpadded);
+}
+
+}
+
+#endif
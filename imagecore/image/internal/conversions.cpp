@@ -25,6 +25,7 @@
 #include "conversions.h"
 #include "platform_support.h"
 #include "imagecore/utils/mathtypes.h"
+#include "imagecore/utils/mathutils.h"
 
 bool ConversionsConfig::m_ScalarMode = false;
 
@@ -113,6 +114,47 @@ void Conversions<useIntrinsics>::rgba_to_yuv420(uint8_t* dstY, uint8_t* dstUV, c
 	}
 }
 
+// Range conversion, integer division truncates towards zero:
+//
+// full range:       Y = clip(255 * (Y - 16) / 219, 0, 255)        UV = clip(255 * (UV - 128) / 224 + 128, 0, 255)
+// compressed range: Y = clip(219 * Y / 255 + 16, 16, 235)         UV = clip(224 * (UV - 128) / 255 + 128, 16, 240)
+//
+// There are only 256 possible inputs per plane, so the scalar version is a lookup table.
+
+struct YUVRangeTables
+{
+	uint8_t table[2][2][256]; // [toFullRange][chroma][input]
+
+	YUVRangeTables()
+	{
+		for(int i = 0; i < 256; i++) {
+			table[1][0][i] = (uint8_t)clamp(0, 255, 255 * (i - 16) / 219);
+			table[1][1][i] = (uint8_t)clamp(0, 255, 255 * (i - 128) / 224 + 128);
+			table[0][0][i] = (uint8_t)clamp(16, 235, 219 * i / 255 + 16);
+			table[0][1][i] = (uint8_t)clamp(16, 240, 224 * (i - 128) / 255 + 128);
+		}
+	}
+};
+
+static const uint8_t* yuv_range_table(bool toFullRange, bool chroma)
+{
+	static const YUVRangeTables tables;
+	return tables.table[toFullRange ? 1 : 0][chroma ? 1 : 0];
+}
+
+template<bool useIntrinsics>
+void Conversions<useIntrinsics>::yuv_range(uint8_t* dst, const uint8_t* src, uint32_t width, uint32_t height, uint32_t inputPitch, uint32_t outputPitch, bool toFullRange, bool chroma)
+{
+	const uint8_t* table = yuv_range_table(toFullRange, chroma);
+	for(uint32_t row = 0; row < height; row++) {
+		for(uint32_t column = 0; column < width; column++) {
+			dst[column] = table[src[column]];
+		}
+		dst += outputPitch;
+		src += inputPitch;
+	}
+}
+
 // forward template declarations
 template class Conversions<false>;
 template class Conversions<true>;
@@ -229,4 +271,63 @@ void Conversions<true>::rgba_to_yuv420(uint8_t* dstY, uint8_t* dstUV, const uint
 #endif
 	rgba_to_yuv420x4(dstY, dstUV, srcRGBA, inputWidth, inputHeight, inputPitch, outputPitchY, outputPitchUV);
 }
+
+// The input is split around the bias into two non negative parts, |x - bias| = max(x - bias, 0) + max(bias - x, 0),
+// so truncation towards zero becomes an unsigned floor on each part. Each part is scaled in 16 bits,
+// numerator * x <= 65025, and divided by multiplying with ceil(2^22 / denominator), which is exact for all 8 bit inputs.
+// The final clip is the saturating pack.
+static inline vSInt16 yuv_range_scale(vSInt16 x, vSInt16 numerator, vUInt16 reciprocal)
+{
+	return v128_shift_right_unsigned_int16<6>(v128_mulhi_unsigned_int16(v128_mul_int16(x, numerator), reciprocal));
+}
+
+static void yuv_range_x16(uint8_t* dst, const uint8_t* src, uint32_t width, uint32_t height, uint32_t inputPitch, uint32_t outputPitch, bool toFullRange, bool chroma)
+{
+	uint32_t columns_processed = width & (~15);
+	if(columns_processed) { // 16 pixels wide version
+		vSInt32 zero = v128_setzero();
+		vUInt8 bias = v128_set_int8(chroma ? 128 : (toFullRange ? 16 : 0));
+		vSInt16 offset = v128_set_int16(chroma ? 128 : (toFullRange ? 0 : 16));
+		vSInt16 numerator = v128_set_int16(toFullRange ? 255 : (chroma ? 224 : 219));
+		vUInt16 reciprocal = v128_set_int16(toFullRange ? (chroma ? 18725 : 19153) : 16449); // 2^22 / 224, 2^22 / 219, 2^22 / 255 rounded up
+
+		const uint8_t* input = src;
+		uint8_t* output = dst;
+		for(uint32_t row = 0; row < height; row++) {
+			for(uint32_t column = 0; column < columns_processed; column += 16) {
+				vUInt8 pixels = v128_load_unaligned((const vSInt32*)&input[column]);
+				vUInt8 above = v128_sub_unsigned_saturate_int8(pixels, bias);
+				vUInt8 below = v128_sub_unsigned_saturate_int8(bias, pixels);
+				vSInt16 lo = v128_add_int16(offset, yuv_range_scale(v128_unpacklo_int8(above, zero), numerator, reciprocal));
+				vSInt16 hi = v128_add_int16(offset, yuv_range_scale(v128_unpackhi_int8(above, zero), numerator, reciprocal));
+				lo = v128_sub_int16(lo, yuv_range_scale(v128_unpacklo_int8(below, zero), numerator, reciprocal));
+				hi = v128_sub_int16(hi, yuv_range_scale(v128_unpackhi_int8(below, zero), numerator, reciprocal));
+				v128_store_unaligned((vSInt32*)&output[column], v128_pack_unsigned_saturate_int16x2(lo, hi));
+			}
+			input += inputPitch;
+			output += outputPitch;
+		}
+	}
+
+	uint32_t columns_remaining = width - columns_processed;
+	if(columns_remaining) {
+		Conversions<false>::yuv_range(&dst[columns_processed], &src[columns_processed], columns_remaining, height, inputPitch, outputPitch, toFullRange, chroma);
+	}
+}
+
+template<>
+void Conversions<true>::yuv_range(uint8_t* dst, const uint8_t* src, uint32_t width, uint32_t height, uint32_t inputPitch, uint32_t outputPitch, bool toFullRange, bool chroma)
+{
+	if(ConversionsConfig::m_ScalarMode) {
+		Conversions<false>::yuv_range(dst, src, width, height, inputPitch, outputPitch, toFullRange, chroma);
+		return;
+	}
+#if IMAGECORE_DETECT_SSE
+	if( !checkForCPUSupport(kCPUFeature_SSE4_1)) {
+		Conversions<false>::yuv_range(dst, src, width, height, inputPitch, outputPitch, toFullRange, chroma);
+		return;
+	}
+#endif
+	yuv_range_x16(dst, src, width, height, inputPitch, outputPitch, toFullRange, chroma);
+}
 #endif
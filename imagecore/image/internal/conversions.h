@@ -38,6 +38,9 @@ class Conversions
 		// converts a single rgb value to yuv
 		static void rgb_to_yuv(int16_t& y, int16_t& u, int16_t& v, uint8_t r, uint8_t g, uint8_t b);
 
+		// converts a single yuv plane between compressed (16..235 luma, 16..240 chroma) and full range
+		static void yuv_range(uint8_t* dst, const uint8_t* src, uint32_t width, uint32_t height, uint32_t inputPitch, uint32_t outputPitch, bool toFullRange, bool chroma);
+
 	private:
 		static const int16_t yr = 76;
 		static const int16_t yg = 150;
@@ -65,5 +68,6 @@ class ConversionsConfig
 
 // SIMD specializations.
 template<> void Conversions<true>::rgba_to_yuv420(uint8_t* dstY, uint8_t* dstUV, const uint8_t* srcRGBA, uint32_t inputWidth, uint32_t inputHeight, uint32_t inputPitch, uint32_t outputPitchY, uint32_t outputPitchUV);
+template<> void Conversions<true>::yuv_range(uint8_t* dst, const uint8_t* src, uint32_t width, uint32_t height, uint32_t inputPitch, uint32_t outputPitch, bool toFullRange, bool chroma);
 
 #endif
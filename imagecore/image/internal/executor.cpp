@@ -0,0 +1,178 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "imagecore/utils/mathutils.h"
+#include "executor.h"
+
+namespace imagecore {
+
+struct ExecutorBatch
+{
+	const Executor::BandFunction* function;
+	unsigned int remaining;
+	// First exception thrown by a band, rethrown by the thread that called runBands.
+	std::exception_ptr error;
+};
+
+struct ExecutorTask
+{
+	ExecutorBatch* batch;
+	unsigned int startRow;
+	unsigned int endRow;
+};
+
+// Workers are detached and never destroyed, so the pool outlives any static destructor that resizes an image.
+struct ExecutorPool
+{
+	std::mutex lock;
+	std::condition_variable work;
+	std::condition_variable done;
+	std::deque<ExecutorTask> tasks;
+	unsigned int numWorkers;
+
+	ExecutorPool()
+	:	numWorkers(0)
+	{
+	}
+};
+
+static ExecutorPool* s_ExecutorPool = new ExecutorPool();
+static unsigned int s_ThreadCount = 1;
+
+static void runTask(ExecutorPool* pool, std::unique_lock<std::mutex>& lock, const ExecutorTask& task)
+{
+	// Once a band failed the others are skipped, the whole pass fails anyway.
+	if( !task.batch->error ) {
+		std::exception_ptr error;
+		lock.unlock();
+		try {
+			(*task.batch->function)(task.startRow, task.endRow);
+		} catch( ... ) {
+			// Letting it out of a detached worker would terminate the process.
+			error = std::current_exception();
+		}
+		lock.lock();
+		if( error && !task.batch->error ) {
+			task.batch->error = error;
+		}
+	}
+	// The batch may be gone as soon as this reaches zero.
+	if( --task.batch->remaining == 0 ) {
+		pool->done.notify_all();
+	}
+}
+
+static void runWorker(ExecutorPool* pool)
+{
+	std::unique_lock<std::mutex> lock(pool->lock);
+	while( true ) {
+		while( pool->tasks.empty() ) {
+			pool->work.wait(lock);
+		}
+		ExecutorTask task = pool->tasks.front();
+		pool->tasks.pop_front();
+		runTask(pool, lock, task);
+	}
+}
+
+void Executor::runBands(unsigned int numRows, const BandFunction& function)
+{
+	ExecutorPool* pool = s_ExecutorPool;
+	unsigned int numBands = 1;
+	{
+		std::lock_guard<std::mutex> lock(pool->lock);
+		numBands = min(s_ThreadCount, numRows / kExecutorMinBandRows);
+		while( pool->numWorkers + 1 < numBands ) {
+			std::thread(runWorker, pool).detach();
+			pool->numWorkers++;
+		}
+	}
+	if( numBands <= 1 ) {
+		function(0, numRows);
+		return;
+	}
+
+	unsigned int bandRows = (numRows + numBands - 1) / numBands;
+	bandRows = (bandRows + kExecutorBandAlignment - 1) & ~(kExecutorBandAlignment - 1);
+	ExecutorBatch batch;
+	batch.function = &function;
+	batch.remaining = 0;
+	std::unique_lock<std::mutex> lock(pool->lock);
+	// The calling thread runs the first band itself.
+	for( unsigned int startRow = bandRows; startRow < numRows; startRow += bandRows ) {
+		ExecutorTask task = { &batch, startRow, min(startRow + bandRows, numRows) };
+		pool->tasks.push_back(task);
+		batch.remaining++;
+	}
+	pool->work.notify_all();
+	lock.unlock();
+	std::exception_ptr error;
+	try {
+		function(0, bandRows);
+	} catch( ... ) {
+		// Queued tasks still point at batch and function, which live on this stack, so wait for them before rethrowing.
+		error = std::current_exception();
+	}
+	lock.lock();
+	if( error && !batch.error ) {
+		batch.error = error;
+	}
+	// Help out instead of just waiting, workers may be busy with bands of other threads' resizes.
+	while( batch.remaining > 0 ) {
+		if( !pool->tasks.empty() ) {
+			ExecutorTask task = pool->tasks.front();
+			pool->tasks.pop_front();
+			runTask(pool, lock, task);
+		} else {
+			pool->done.wait(lock);
+		}
+	}
+	lock.unlock();
+	if( batch.error ) {
+		std::rethrow_exception(batch.error);
+	}
+}
+
+}
+
+void ImageCoreSetThreadCount(unsigned int threadCount)
+{
+	if( threadCount == 0 ) {
+		threadCount = max(std::thread::hardware_concurrency(), 1U);
+	}
+	std::lock_guard<std::mutex> lock(imagecore::s_ExecutorPool->lock);
+	imagecore::s_ThreadCount = threadCount;
+}
+
+unsigned int ImageCoreGetThreadCount()
+{
+	std::lock_guard<std::mutex> lock(imagecore::s_ExecutorPool->lock);
+	return imagecore::s_ThreadCount;
+}
@@ -0,0 +1,48 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <functional>
+
+#include "imagecore/imagecore.h"
+
+namespace imagecore {
+
+// Bands start on multiples of this many rows, the most any filter processes at once.
+const unsigned int kExecutorBandAlignment = 16;
+// Smaller passes aren't worth handing to other threads.
+const unsigned int kExecutorMinBandRows = 64;
+
+class Executor
+{
+public:
+	typedef std::function<void(unsigned int startRow, unsigned int endRow)> BandFunction;
+
+	// Splits rows [0, numRows) into bands and runs them on up to ImageCoreSetThreadCount() threads,
+	// the calling thread included. Returns once every band is done, rethrowing the first exception a band threw.
+	static void runBands(unsigned int numRows, const BandFunction& function);
+};
+
+}
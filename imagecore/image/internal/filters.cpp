@@ -480,6 +480,23 @@ void Filters<Component>::transpose(const uint8_t* __restrict input_buffer, uint8
 	}
 }
 
+template<typename Component>
+uint64_t Filters<Component>::sumAbsoluteDifferences(const uint8_t* bufferA, const uint8_t* bufferB, unsigned int width, unsigned int height, unsigned int pitchA, unsigned int pitchB)
+{
+	unsigned int rowLength = SafeUMul(width, COMPONENT_SIZE);
+	uint64_t sum = 0;
+	for( unsigned int y = 0; y < height; y++ ) {
+		const uint8_t* rowA = bufferA + y * pitchA;
+		const uint8_t* rowB = bufferB + y * pitchB;
+		uint32_t rowSum = 0;
+		for( unsigned int i = 0; i < rowLength; i++ ) {
+			rowSum += rowA[i] > rowB[i] ? rowA[i] - rowB[i] : rowB[i] - rowA[i];
+		}
+		sum += rowSum;
+	}
+	return sum;
+}
+
 template<typename Component>
 bool Filters<Component>::fasterUnpadded(uint32_t kernelSize)
 {
@@ -45,6 +45,7 @@ public:
 	static void rotateUp(const uint8_t* __restrict input_buffer, uint8_t* __restrict output_buffer, unsigned int width, unsigned int height, unsigned int input_pitch, unsigned int output_pitch,  unsigned int output_capacity);
 	static void transpose(const uint8_t* __restrict input_buffer, uint8_t* __restrict output_buffer, unsigned int width, unsigned int height, unsigned int input_pitch, unsigned int output_pitch,  unsigned int output_capacity);
 	static void bilinearTwoLines(uint8_t* dstRow, const uint8_t* srcRow0, const uint8_t* srcRow1, uint16_t coeff0, uint16_t coeff1, uint32_t length);
+	static uint64_t sumAbsoluteDifferences(const uint8_t* bufferA, const uint8_t* bufferB, unsigned int width, unsigned int height, unsigned int pitchA, unsigned int pitchB);
 	static bool fasterUnpadded(uint32_t kernelSize);
 	static bool supportsUnpadded(uint32_t kernelSize);
 };
@@ -74,6 +75,7 @@ template<> void Filters<ComponentSIMD<1>>::transpose(const uint8_t* __restrict i
 template<> void Filters<ComponentSIMD<2>>::transpose(const uint8_t* __restrict input_buffer, uint8_t* __restrict output_buffer, unsigned int width, unsigned int height, unsigned int input_pitch, unsigned int output_pitch,  unsigned int output_capacity);
 template<> void Filters<ComponentSIMD<1>>::bilinearTwoLines(uint8_t* dstRow, const uint8_t* srcRow0, const uint8_t* srcRow1, uint16_t coeff0, uint16_t coeff1, uint32_t length);
 template<> void Filters<ComponentSIMD<2>>::bilinearTwoLines(uint8_t* dstRow, const uint8_t* srcRow0, const uint8_t* srcRow1, uint16_t coeff0, uint16_t coeff1, uint32_t length);
+template<> uint64_t Filters<ComponentSIMD<1>>::sumAbsoluteDifferences(const uint8_t* bufferA, const uint8_t* bufferB, unsigned int width, unsigned int height, unsigned int pitchA, unsigned int pitchB);
 
 #endif
 
@@ -85,4 +87,20 @@ template<> bool Filters<ComponentSIMD<1>>::supportsUnpadded(uint32_t kernelSize)
 
 #endif
 
+#if __SSE4_1__
+
+// AVX2 versions of the SSE specializations, built with a per function target so the library still runs on SSE4.1 only machines.
+// The SSE specializations hand over to them when checkForCPUSupport(kCPUFeature_AVX2) is true.
+template<typename Component>
+class FiltersAVX2
+{
+public:
+	static void adaptiveSeperable(const FilterKernelAdaptive* kernel, const uint8_t* __restrict inputBuffer, unsigned int inputWidth, unsigned int input_height, unsigned int inputPitch, uint8_t* __restrict outputBuffer, unsigned int outputWidth, unsigned int outputHeight, unsigned int outputPitch, unsigned int outputCapacity, bool unpadded);
+};
+
+template<> void FiltersAVX2<ComponentSIMD<4>>::adaptiveSeperable(const FilterKernelAdaptive* kernel, const uint8_t* __restrict inputBuffer, unsigned int inputWidth, unsigned int input_height, unsigned int inputPitch, uint8_t* __restrict outputBuffer, unsigned int outputWidth, unsigned int outputHeight, unsigned int outputPitch, unsigned int outputCapacity, bool unpadded);
+template<> void FiltersAVX2<ComponentSIMD<1>>::adaptiveSeperable(const FilterKernelAdaptive* kernel, const uint8_t* __restrict inputBuffer, unsigned int inputWidth, unsigned int input_height, unsigned int inputPitch, uint8_t* __restrict outputBuffer, unsigned int outputWidth, unsigned int outputHeight, unsigned int outputPitch, unsigned int outputCapacity, bool unpadded);
+
+#endif
+
 }
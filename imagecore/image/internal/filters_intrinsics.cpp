@@ -519,6 +519,41 @@ void Filters<ComponentSIMD<2>>::bilinearTwoLines(uint8_t* dstRow, const uint8_t*
 	bilinearTwoLinesx16<2>(dstRow, srcRow0, srcRow1, coeff0, coeff1, length);
 }
 
+static uint64_t sumAbsoluteDifferencesx16(const uint8_t* bufferA, const uint8_t* bufferB, unsigned int width, unsigned int height, unsigned int pitchA, unsigned int pitchB)
+{
+	unsigned int rowLength = width & (~0xF); // align on 16 byte boundary
+	uint64_t sum = 0;
+	if(rowLength > 0) {
+		vUInt64 sum_64 = v128_setzero();
+		for( unsigned int y = 0; y < height; y++ ) {
+			const uint8_t* rowA = bufferA + y * pitchA;
+			const uint8_t* rowB = bufferB + y * pitchB;
+			for( unsigned int x = 0; x < rowLength; x += 16 ) {
+				vUInt8 a = v128_load_unaligned((const vSInt32*)(rowA + x));
+				vUInt8 b = v128_load_unaligned((const vSInt32*)(rowB + x));
+				sum_64 = v128_add_int64(sum_64, v128_sad_unsigned_int8(a, b));
+			}
+		}
+		sum = v128_horizontal_add_int64(sum_64);
+	}
+	// less than 16 pixels left per row
+	return sum + Filters<ComponentScalar<1>>::sumAbsoluteDifferences(bufferA + rowLength, bufferB + rowLength, width - rowLength, height, pitchA, pitchB);
+}
+
+template<>
+uint64_t Filters<ComponentSIMD<1>>::sumAbsoluteDifferences(const uint8_t* bufferA, const uint8_t* bufferB, unsigned int width, unsigned int height, unsigned int pitchA, unsigned int pitchB)
+{
+	if(FiltersConfig::m_ScalarMode) {
+		return Filters<ComponentScalar<1>>::sumAbsoluteDifferences(bufferA, bufferB, width, height, pitchA, pitchB);
+	}
+#if IMAGECORE_DETECT_SSE
+	if( !checkForCPUSupport(kCPUFeature_SSE4_1)) {
+		return Filters<ComponentScalar<1>>::sumAbsoluteDifferences(bufferA, bufferB, width, height, pitchA, pitchB);
+	}
+#endif
+	return sumAbsoluteDifferencesx16(bufferA, bufferB, width, height, pitchA, pitchB);
+}
+
 }
 
 #endif
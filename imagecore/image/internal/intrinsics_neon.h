@@ -34,6 +34,7 @@
 #define vSInt16 int16x8_t
 #define vSInt32 int32x4_t
 #define vSInt64 int64x2_t
+#define vUInt64 uint64x2_t
 #define vMask128 uint64x1x2_t
 
 #define V64_MASK_LO(e7, e6, e5, e4, e3, e2, e1, e0) (uint64_t)(e0) \
@@ -113,6 +114,11 @@ inline vSInt16 v128_set_int16(uint16_t a)
 	return vdupq_n_s16(a);
 }
 
+inline vUInt8 v128_set_int8(uint8_t a)
+{
+	return vdupq_n_u8(a);
+}
+
 inline vUInt8 v128_set_int8_packed(char e15, char e14, char e13, char e12, char e11, char e10, char e9, char e8, char e7, char e6, char e5, char e4, char e3, char e2, char e1, char e0)
 {
 	vUInt8 res = v128_setzero();
@@ -152,6 +158,11 @@ inline void v64_store(vSInt32* mem_addr, vUInt8x8 a)
 	vst1_u8((uint8_t*)mem_addr, a);
 }
 
+inline void v128_store_unaligned(vSInt32* mem_addr, vUInt8 a)
+{
+	vst1q_u8((uint8_t*)mem_addr, a);
+}
+
 // conversions
 inline int32_t v128_convert_to_int32(vUInt8 a)
 {
@@ -180,17 +191,58 @@ inline vUInt16 v128_add_int16(vUInt16 a, vUInt16 b)
 	return vaddq_u16(a, b);
 }
 
+inline vSInt16 v128_sub_int16(vSInt16 a, vSInt16 b)
+{
+	return vsubq_s16(a, b);
+}
+
+inline vUInt8 v128_sub_unsigned_saturate_int8(vUInt8 a, vUInt8 b)
+{
+	return vqsubq_u8(a, b);
+}
+
+inline vUInt64 v128_add_int64(vUInt64 a, vUInt64 b)
+{
+	return vaddq_u64(a, b);
+}
+
+// sums of the absolute differences of the low and of the high 8 bytes, as two 64 bit lanes
+inline vUInt64 v128_sad_unsigned_int8(vUInt8 a, vUInt8 b)
+{
+	return vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vabdq_u8(a, b))));
+}
+
+inline int64_t v128_horizontal_add_int64(vUInt64 a)
+{
+	return vgetq_lane_u64(a, 0) + vgetq_lane_u64(a, 1);
+}
+
 inline vSInt16 v128_mul_int16(vSInt16 a, vSInt16 b)
 {
 	return vmulq_s16(a, b);
 }
 
+inline vUInt16 v128_mulhi_unsigned_int16(vUInt16 a, vUInt16 b)
+{
+	return vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(a), vget_low_u16(b)), 16), vshrn_n_u32(vmull_u16(vget_high_u16(a), vget_high_u16(b)), 16));
+}
+
 inline vUInt8x8 v64_add_int16(vUInt8x8 a, vUInt8x8 b)
 {
 	return vadd_u16(a, b);
 }
 
 // unpack
+inline vUInt8 v128_unpacklo_int8(vUInt8 a, vUInt8 b)
+{
+	return vzipq_u8(a, b).val[0];
+}
+
+inline vUInt8 v128_unpackhi_int8(vUInt8 a, vUInt8 b)
+{
+	return vzipq_u8(a, b).val[1];
+}
+
 inline void v128_unpack_int8(vSInt8& a, vSInt8& b, vUInt8 c, vUInt8 d)
 {
 	int8x16x2_t unpacked = vzipq_s8(c, d);
@@ -225,6 +277,12 @@ inline vUInt8x8 v128_pack_unsigned_saturate_int16(vUInt16 a, vUInt16, vUInt16)
 	return vmovn_u16(a);
 }
 
+// packs 8 + 8 signed 16 bit lanes into 16 unsigned bytes, same on every platform
+inline vUInt8 v128_pack_unsigned_saturate_int16x2(vSInt16 a, vSInt16 b)
+{
+	return vcombine_u8(vqmovun_s16(a), vqmovun_s16(b));
+}
+
 inline vUInt8x8 v64_pack_unsigned_saturate_int16(vUInt8x8 a, vUInt16, vUInt8x8 mask)
 {
 	return vtbl1_u8(a, mask);
@@ -130,6 +130,11 @@ inline v128i v128_set_int16(int16_t a)
 	return _mm_set1_epi16(a);
 }
 
+inline v128i v128_set_int8(int8_t a)
+{
+	return _mm_set1_epi8(a);
+}
+
 inline v128i v128_set_int8_packed(int8_t e15, int8_t e14, int8_t e13, int8_t e12, int8_t e11, int8_t e10, int8_t e9, int8_t e8, int8_t e7, int8_t e6, int8_t e5, int8_t e4, int8_t e3, int8_t e2, int8_t e1, int8_t e0)
 {
 	return _mm_set_epi8(e15, e14, e13, e12, e11, e10, e9, e8, e7, e6, e5, e4, e3, e2, e1, e0);
@@ -217,11 +222,42 @@ inline v128i v128_add_int32(v128i a, v128i b)
 	return _mm_add_epi32(a, b);
 }
 
+inline v128i v128_add_int64(v128i a, v128i b)
+{
+	return _mm_add_epi64(a, b);
+}
+
+inline v128i v128_sub_int16(v128i a, v128i b)
+{
+	return _mm_sub_epi16(a, b);
+}
+
+inline v128i v128_sub_unsigned_saturate_int8(v128i a, v128i b)
+{
+	return _mm_subs_epu8(a, b);
+}
+
+// sums of the absolute differences of the low and of the high 8 bytes, as two 64 bit lanes
+inline v128i v128_sad_unsigned_int8(v128i a, v128i b)
+{
+	return _mm_sad_epu8(a, b);
+}
+
+inline int64_t v128_horizontal_add_int64(v128i a)
+{
+	return v128_convert_to_int64(_mm_add_epi64(a, _mm_unpackhi_epi64(a, a)));
+}
+
 inline v128i v128_mul_int16(v128i a, v128i b)
 {
 	return _mm_mullo_epi16(a, b);
 }
 
+inline v128i v128_mulhi_unsigned_int16(v128i a, v128i b)
+{
+	return _mm_mulhi_epu16(a, b);
+}
+
 inline v128i v128_mul_int32(v128i a, v128i b)
 {
 	return _mm_mullo_epi32(a, b);
@@ -274,6 +310,12 @@ inline v128i v128_pack_unsigned_saturate_int16(v128i a, v128i b, v128i)
 	return _mm_packus_epi16(a, b);
 }
 
+// packs 8 + 8 signed 16 bit lanes into 16 unsigned bytes, same on every platform
+inline v128i v128_pack_unsigned_saturate_int16x2(v128i a, v128i b)
+{
+	return _mm_packus_epi16(a, b);
+}
+
 inline v128i v128_pack_unsigned_saturate_int32(v128i a, v128i b)
 {
 	return _mm_packus_epi32(a, b);
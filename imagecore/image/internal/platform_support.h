@@ -32,7 +32,8 @@ enum ECPUFeature
 	kCPUFeature_SSE3_S  = 0x08,
 	kCPUFeature_SSE4_1  = 0x10,
 	kCPUFeature_SSE4_2  = 0x20,
-	kCPUFeature_AVX     = 0x40
+	kCPUFeature_AVX     = 0x40,
+	kCPUFeature_AVX2    = 0x80
 };
 
 
@@ -642,6 +642,9 @@ void Filters<ComponentSIMD<4>>::adaptiveSeperable(const FilterKernelAdaptive* ke
         return Filters<ComponentScalar<4>>::adaptiveSeperable(kernel, inputBuffer, inputWidth, inputHeight, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch, outputCapacity, unpadded);
     }
 #endif
+	if( checkForCPUSupport(kCPUFeature_AVX2) ) {
+		return FiltersAVX2<ComponentSIMD<4>>::adaptiveSeperable(kernel, inputBuffer, inputWidth, inputHeight, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch, outputCapacity, unpadded);
+	}
 	unsigned int kernelSize = kernel->getKernelSize();
 	if( kernelSize == 8U ) {
 		adaptiveSeperable8(kernel, inputBuffer, inputWidth, inputHeight, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch, outputCapacity);
@@ -1152,6 +1155,9 @@ template<> void Filters<ComponentSIMD<1>>::adaptiveSeperable(const FilterKernelA
         return Filters<ComponentScalar<1>>::adaptiveSeperable(kernel, inputBuffer, inputWidth, inputHeight, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch, outputCapacity, unpadded);
     }
 #endif
+	if( checkForCPUSupport(kCPUFeature_AVX2) ) {
+		return FiltersAVX2<ComponentSIMD<1>>::adaptiveSeperable(kernel, inputBuffer, inputWidth, inputHeight, inputPitch, outputBuffer, outputWidth, outputHeight, outputPitch, outputCapacity, unpadded);
+	}
 	unsigned int kernelSize = kernel->getKernelSize();
 	if( kernelSize == 8U ) {
 		// TODO
@@ -139,6 +139,7 @@ FilterFunction s_FilterFunctionsFixed[kFilterType_MAX] = { lanczos_fixed, lanczo
 
 FilterKernel::FilterKernel()
 {
+	m_OwnsTables = true;
 	m_InSampleOffset = 0;
 	m_OutSampleOffset = 0;
 	m_SampleRatio = 1.0f;
@@ -186,10 +187,12 @@ void FilterKernel::setSampleOffset(unsigned int inSampleOffset, unsigned int out
 
 FilterKernel::~FilterKernel()
 {
-	delete[] m_Table;
-	delete[] m_TableBilinear;
-	delete[] m_TableFixedPoint;
-	delete[] m_TableFixedPoint4;
+	if( m_OwnsTables ) {
+		delete[] m_Table;
+		delete[] m_TableBilinear;
+		delete[] m_TableFixedPoint;
+		delete[] m_TableFixedPoint4;
+	}
 }
 
 // Uses a dynamic number of taps per sample, based on on the filter window size and the scaling factor.
@@ -246,6 +249,12 @@ FilterKernelAdaptive::FilterKernelAdaptive(EFilterType type, unsigned int kernel
 	generateFixedPoint(type);
 }
 
+FilterKernelAdaptive::FilterKernelAdaptive(const FilterKernelAdaptive& kernel)
+:	FilterKernel(kernel)
+{
+	m_OwnsTables = false;
+}
+
 // Always takes 4 fixed samples, regardless of the scaling factor.
 FilterKernelFixed::FilterKernelFixed(EFilterType type, unsigned int inSize, unsigned int outSize)
 :	FilterKernel()
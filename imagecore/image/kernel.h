@@ -86,6 +86,7 @@ public:
 
 protected:
 	void generateFixedPoint(EFilterType type);
+	bool m_OwnsTables;
 	unsigned int m_InSampleOffset;
 	unsigned int m_OutSampleOffset;
 	unsigned int m_KernelSize;
@@ -103,6 +104,8 @@ class FilterKernelAdaptive : public FilterKernel
 {
 public:
 	FilterKernelAdaptive(EFilterType type, unsigned int kernelSize, unsigned int inSize, unsigned int outSize);
+	// Shares the (read only) tables of kernel, which has to outlive the copy, but has its own sample offsets.
+	FilterKernelAdaptive(const FilterKernelAdaptive& kernel);
 
 	int computeSampleStart(int outPosition) const
 	{
@@ -22,12 +22,61 @@
  * SOFTWARE.
  */
 
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 #include "imagecore/image/rgba.h"
 #include "imagecore/image/tiledresize.h"
 #include "imagecore/utils/mathutils.h"
 
 namespace imagecore {
 
+// One tile being read, one being filtered and one being written.
+static const unsigned int kMaxPipelinedTiles = 3;
+
+enum ETileState
+{
+	kTileState_Free,
+	kTileState_Read,
+	kTileState_Filtered
+};
+
+struct ResizeTile
+{
+	ImageRGBA* sourceImage;
+	ImageRGBA* destImage1;
+	ImageRGBA* destImage2;
+	// Shares the tables of the operation's vertical kernel, with the sample offsets of this tile.
+	FilterKernelAdaptive* filterKernelY;
+	ImageRGBA* image;
+	int inSampleOffset;
+	int outSampleOffset;
+	unsigned int outRows;
+	unsigned int outPreOverlap;
+	unsigned int outPostOverlap;
+	ETileState state;
+};
+
+struct ResizeTilePipeline
+{
+	ResizeTile tiles[kMaxPipelinedTiles];
+	unsigned int numTiles;
+	unsigned int tilesRead;
+	bool readDone;
+	bool failed;
+	// First exception thrown by a stage (e.g. by the assertion handler), rethrown by performResize.
+	std::exception_ptr error;
+	std::mutex lock;
+	std::condition_variable changed;
+	ImageWriter* imageWriter;
+	FilterKernelAdaptive* filterKernelX;
+	unsigned int targetWidth;
+	bool skipScale;
+	bool skipFiltering;
+};
+
 TiledResizeOperation::TiledResizeOperation(ImageReader* imageReader, ImageWriter* imageWriter, unsigned int outputWidth, unsigned int outputHeight)
 {
 	m_ImageReader = imageReader;
@@ -35,6 +84,7 @@ TiledResizeOperation::TiledResizeOperation(ImageReader* imageReader, ImageWriter
 	m_OutputWidth = outputWidth;
 	m_OutputHeight = outputHeight;
 	m_ResizeQuality = kResizeQuality_High;
+	m_Parallel = false;
 }
 
 TiledResizeOperation::~TiledResizeOperation()
@@ -78,6 +128,115 @@ ImageRGBA* resizeTile(ImageRGBA* source, ImageRGBA* dest1, ImageRGBA* dest2, int
 	return outImages[whichOutImage ^ 1];
 }
 
+bool filterTile(ResizeTilePipeline* pipeline, ResizeTile* tile)
+{
+	if( pipeline->skipScale ) {
+		tile->image = tile->sourceImage;
+		return true;
+	}
+
+	// Perform the resize of the tile.
+	unsigned int outHeight = tile->outRows + tile->outPreOverlap + tile->outPostOverlap;
+	tile->destImage1->setDimensions(pipeline->targetWidth, outHeight);
+	tile->destImage2->setDimensions(pipeline->targetWidth, outHeight);
+	tile->filterKernelY->setSampleOffset(tile->inSampleOffset, tile->outSampleOffset);
+	ImageRGBA* image = resizeTile(tile->sourceImage, tile->destImage1, tile->destImage2, tile->inSampleOffset, tile->outSampleOffset, pipeline->filterKernelX, tile->filterKernelY, pipeline->skipFiltering);
+	if( image == NULL ) {
+		return false;
+	}
+	// For writing we skip past the top few rows, which are from the previous tile.
+	image->setOffset(0, tile->outPreOverlap);
+	image->setDimensions(pipeline->targetWidth, tile->outRows);
+	tile->image = image;
+	return true;
+}
+
+bool writeTile(ResizeTilePipeline* pipeline, ResizeTile* tile)
+{
+	ImageRGBA* image = tile->image;
+	START_CLOCK(write);
+	unsigned int rowsWritten = pipeline->imageWriter->writeRows(image, 0, image->getHeight());
+	END_CLOCK(write);
+	image->setOffset(0, 0);
+	return rowsWritten == image->getHeight();
+}
+
+// Runs one stage of the pipeline on a worker thread, over the tiles in the order they were read.
+void runTileStage(ResizeTilePipeline* pipeline, ETileState inState, ETileState outState, bool (*process)(ResizeTilePipeline*, ResizeTile*))
+{
+	for( unsigned int tileIndex = 0; ; tileIndex++ ) {
+		ResizeTile* tile = &pipeline->tiles[tileIndex % pipeline->numTiles];
+		{
+			std::unique_lock<std::mutex> lock(pipeline->lock);
+			while( !pipeline->failed && tile->state != inState && !(pipeline->readDone && tileIndex >= pipeline->tilesRead) ) {
+				pipeline->changed.wait(lock);
+			}
+			if( pipeline->failed || tileIndex >= pipeline->tilesRead ) {
+				return;
+			}
+		}
+		bool success = false;
+		std::exception_ptr error;
+		try {
+			success = process(pipeline, tile);
+		} catch( ... ) {
+			// Letting it out of the thread would terminate the process.
+			error = std::current_exception();
+		}
+		{
+			std::lock_guard<std::mutex> lock(pipeline->lock);
+			if( !success ) {
+				// Abort, stop processing tiles.
+				pipeline->failed = true;
+			}
+			if( error && !pipeline->error ) {
+				pipeline->error = error;
+			}
+			tile->state = outState;
+		}
+		pipeline->changed.notify_all();
+	}
+}
+
+// Joins the stage threads on every way out of performResize, aborting the pipeline when it did not get to the end.
+struct TileStageThreads
+{
+	ResizeTilePipeline* pipeline;
+	std::thread filterThread;
+	std::thread writeThread;
+
+	TileStageThreads(ResizeTilePipeline* pipeline)
+	:	pipeline(pipeline)
+	{
+	}
+
+	~TileStageThreads()
+	{
+		join(true);
+	}
+
+	void join(bool failed)
+	{
+		if( !filterThread.joinable() && !writeThread.joinable() ) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(pipeline->lock);
+			if( failed ) {
+				pipeline->failed = true;
+			}
+			pipeline->readDone = true;
+		}
+		pipeline->changed.notify_all();
+		if( filterThread.joinable() ) {
+			filterThread.join();
+		}
+		if( writeThread.joinable() ) {
+			writeThread.join();
+		}
+	}
+};
+
 int TiledResizeOperation::performResize()
 {
 	unsigned int targetWidth = (unsigned int)m_OutputWidth;
@@ -136,6 +295,7 @@ int TiledResizeOperation::performResize()
 	EImageColorModel colorModel = m_ImageReader->getNativeColorModel() == kColorModel_RGBA ? kColorModel_RGBA : kColorModel_RGBX;
 
 	bool success = false;
+	std::exception_ptr error;
 
 	// If the image is just too big (> ~8192), don't even try.
 	// It might work, but it's untested.
@@ -146,102 +306,151 @@ int TiledResizeOperation::performResize()
 			if( m_ImageReader->beginRead(readWidth, readHeight, colorModel) ) {
 				if( m_ImageWriter->beginWrite(targetWidth, targetHeight, colorModel) ) {
 					unsigned int maxSourceHeight = inMaxRows + tileOverlap * 4;
-					ImageRGBA* sourceImage = ImageRGBA::create(readWidth, maxSourceHeight, imagePadding, 16);
-					ImageRGBA* destImage1 = skipScale ? NULL : ImageRGBA::create(readWidth, outMaxRows + tileOverlap * 2, imagePadding, 16);
-					ImageRGBA* destImage2 = skipScale ? NULL : ImageRGBA::create(readWidth, outMaxRows + tileOverlap * 2, imagePadding, 16);
+					ResizeTilePipeline pipeline;
+					pipeline.numTiles = m_Parallel ? kMaxPipelinedTiles : 1;
+					pipeline.tilesRead = 0;
+					pipeline.readDone = false;
+					pipeline.failed = false;
+					pipeline.imageWriter = m_ImageWriter;
+					pipeline.filterKernelX = filterKernelX;
+					pipeline.targetWidth = targetWidth;
+					pipeline.skipScale = skipScale;
+					pipeline.skipFiltering = skipFiltering;
+					bool allocated = true;
+					for( unsigned int i = 0; i < pipeline.numTiles; i++ ) {
+						ResizeTile* tile = &pipeline.tiles[i];
+						tile->sourceImage = ImageRGBA::create(readWidth, maxSourceHeight, imagePadding, 16);
+						tile->destImage1 = skipScale ? NULL : ImageRGBA::create(readWidth, outMaxRows + tileOverlap * 2, imagePadding, 16);
+						tile->destImage2 = skipScale ? NULL : ImageRGBA::create(readWidth, outMaxRows + tileOverlap * 2, imagePadding, 16);
+						tile->filterKernelY = new FilterKernelAdaptive(*filterKernelY);
+						tile->image = NULL;
+						tile->state = kTileState_Free;
+						if( tile->sourceImage == NULL || ((tile->destImage1 == NULL || tile->destImage2 == NULL) && !skipScale) ) {
+							allocated = false;
+						}
+					}
+					// The bottom of each tile is kept here, as the top of the next one.
+					ImageRGBA* overlapImage = ImageRGBA::create(readWidth, maxSourceHeight, imagePadding, 16);
 					unsigned int prevTileUnprocessed = 0;
 					unsigned int prevTileOverlap = 0;
-					if( sourceImage != NULL && ((destImage1 != NULL && destImage2 != NULL) || skipScale) ) {
+					if( allocated && overlapImage != NULL ) {
+						TileStageThreads threads(&pipeline);
+						if( m_Parallel ) {
+							threads.filterThread = std::thread(runTileStage, &pipeline, kTileState_Read, kTileState_Filtered, filterTile);
+							threads.writeThread = std::thread(runTileStage, &pipeline, kTileState_Filtered, kTileState_Free, writeTile);
+						}
 						unsigned int currentInRow = 0;
 						unsigned int currentOutRow = 0;
 						unsigned int rowsInRemaining = readHeight;
 						unsigned int rowsOutRemaining = targetHeight;
 						bool failed = false;
-						while( rowsOutRemaining > 0 ) {
-							unsigned int desiredInRows = inMaxRows;
-							if( currentOutRow == 0 ) {
-								// For the first tile we need to load a bit of the next one, for proper filtering.
-								desiredInRows += tileOverlap;
-							}
+						try {
+							for( unsigned int tileIndex = 0; rowsOutRemaining > 0; tileIndex++ ) {
+								ResizeTile* tile = &pipeline.tiles[tileIndex % pipeline.numTiles];
+								if( m_Parallel ) {
+									// Wait for the tile that used these images last to be written.
+									std::unique_lock<std::mutex> lock(pipeline.lock);
+									while( !pipeline.failed && tile->state != kTileState_Free ) {
+										pipeline.changed.wait(lock);
+									}
+									if( pipeline.failed ) {
+										break;
+									}
+								}
+								ImageRGBA* sourceImage = tile->sourceImage;
 
-							unsigned int effectiveInRows = min(rowsInRemaining + prevTileUnprocessed, inMaxRows);
-							unsigned int effectiveOutRows = min(rowsOutRemaining, outMaxRows);
+								unsigned int desiredInRows = inMaxRows;
+								if( currentOutRow == 0 ) {
+									// For the first tile we need to load a bit of the next one, for proper filtering.
+									desiredInRows += tileOverlap;
+								}
 
-							unsigned int rowsToRead = min(rowsInRemaining, desiredInRows);
-							if( rowsOutRemaining == effectiveOutRows ) {
-								rowsToRead = rowsInRemaining;
-							}
+								unsigned int effectiveInRows = min(rowsInRemaining + prevTileUnprocessed, inMaxRows);
+								unsigned int effectiveOutRows = min(rowsOutRemaining, outMaxRows);
 
-							if( rowsToRead > 0 ) {
-								sourceImage->setDimensions(readWidth, rowsToRead);
-								// Start loading the next tile into the image below the part of the previous tile we kept around.
-								sourceImage->setOffset(0, prevTileUnprocessed + prevTileOverlap);
-								START_CLOCK(read);
-								unsigned int rowsRead = m_ImageReader->readRows(sourceImage, 0, rowsToRead);
-								END_CLOCK(read);
-								if( rowsRead != rowsToRead ) {
+								unsigned int rowsToRead = min(rowsInRemaining, desiredInRows);
+								if( rowsOutRemaining == effectiveOutRows ) {
+									rowsToRead = rowsInRemaining;
+								}
+
+								if( prevTileUnprocessed + prevTileOverlap > 0 ) {
+									// The part of the previous tile we kept around serves as the filter edge padding for this one.
+									sourceImage->setDimensions(readWidth, maxSourceHeight);
+									overlapImage->copyRect(sourceImage, 0, 0, 0, 0, readWidth, prevTileUnprocessed + prevTileOverlap);
+								}
+
+								if( rowsToRead > 0 ) {
+									sourceImage->setDimensions(readWidth, rowsToRead);
+									// Start loading the next tile into the image below the part of the previous tile we kept around.
+									sourceImage->setOffset(0, prevTileUnprocessed + prevTileOverlap);
+									START_CLOCK(read);
+									unsigned int rowsRead = m_ImageReader->readRows(sourceImage, 0, rowsToRead);
+									END_CLOCK(read);
+									if( rowsRead != rowsToRead ) {
+										failed = true;
+										// Abort, stop processing tiles.
+										break;
+									}
+									sourceImage->setOffset(0, 0);
+								}
+
+								unsigned int rowsProcessed = effectiveInRows;
+								unsigned int rowsAvailable = prevTileUnprocessed + rowsToRead;
+								unsigned int rowsLeftOver = rowsAvailable - rowsProcessed;
+
+								int outPreOverlap = ((targetHeight * prevTileOverlap) / readHeight);
+								int outPostOverlap = ((targetHeight * rowsLeftOver) / readHeight);
+
+								sourceImage->setDimensions(readWidth, rowsProcessed + prevTileOverlap + rowsLeftOver);
+
+								// Setting these sample offsets allows us to filter the tile exactly the same way it would be
+								// if the entire image was being filtered. The filter kernel was constructed for the entire image.
+								tile->inSampleOffset = currentInRow - prevTileOverlap;
+								tile->outSampleOffset = currentOutRow - outPreOverlap;
+								tile->outRows = effectiveOutRows;
+								tile->outPreOverlap = outPreOverlap;
+								tile->outPostOverlap = outPostOverlap;
+
+								if( rowsLeftOver > 0 ) {
+									// Copy the bottom of this tile away before it's filtered, so it can be put on top of the next one.
+									sourceImage->copyRect(overlapImage, 0, prevTileOverlap + rowsProcessed - tileOverlap, 0, 0, readWidth, rowsLeftOver + tileOverlap);
+									prevTileUnprocessed = rowsLeftOver;
+									prevTileOverlap = tileOverlap;
+								} else {
+									prevTileUnprocessed = 0;
+									prevTileOverlap = 0;
+								}
+
+								if( m_Parallel ) {
+									{
+										std::lock_guard<std::mutex> lock(pipeline.lock);
+										tile->state = kTileState_Read;
+										pipeline.tilesRead++;
+									}
+									pipeline.changed.notify_all();
+								} else if( !filterTile(&pipeline, tile) || !writeTile(&pipeline, tile) ) {
 									failed = true;
 									// Abort, stop processing tiles.
 									break;
 								}
-								sourceImage->setOffset(0, 0);
-							}
 
-							unsigned int rowsProcessed = effectiveInRows;
-							unsigned int rowsAvailable = prevTileUnprocessed + rowsToRead;
-							unsigned int rowsLeftOver = rowsAvailable - rowsProcessed;
-
-							int outPreOverlap = ((targetHeight * prevTileOverlap) / readHeight);
-							int outPostOverlap = ((targetHeight * rowsLeftOver) / readHeight);
-
-							sourceImage->setDimensions(readWidth, rowsProcessed + prevTileOverlap + rowsLeftOver);
-
-							// Setting these sample offsets allows us to filter the tile exactly the same way it would be
-							// if the entire image was being filtered. The filter kernel was constructed for the entire image.
-							int inSampleOffset = currentInRow - prevTileOverlap;
-							int outSampleOffset = currentOutRow - outPreOverlap;
-							filterKernelY->setSampleOffset(inSampleOffset, outSampleOffset);
-
-							ImageRGBA* image = NULL;
-
-							if( skipScale ) {
-								image = sourceImage;
-							} else {
-								// Perform the resize of the tile.
-								destImage1->setDimensions(targetWidth, effectiveOutRows + outPreOverlap + outPostOverlap);
-								destImage2->setDimensions(targetWidth, effectiveOutRows + outPreOverlap + outPostOverlap);
-								image = resizeTile(sourceImage, destImage1, destImage2, inSampleOffset, outSampleOffset, filterKernelX, filterKernelY, skipFiltering);
-								// For writing we skip past the top few rows, which are from the previous tile.
-								image->setOffset(0, outPreOverlap);
-								image->setDimensions(targetWidth, effectiveOutRows);
+								currentInRow += rowsProcessed;
+								currentOutRow += effectiveOutRows;
+								rowsOutRemaining -= effectiveOutRows;
+								rowsInRemaining -= rowsToRead;
 							}
+						} catch( ... ) {
+							// E.g. from readRows or the assertion handler, rethrown once the workers are joined and the tiles are freed.
+							error = std::current_exception();
+							failed = true;
+						}
 
-							START_CLOCK(write);
-							unsigned int rowsWritten = m_ImageWriter->writeRows(image, 0, image->getHeight());
-							END_CLOCK(write);
-							if( rowsWritten != image->getHeight() ) {
-								failed = true;
-								// Abort, stop processing tiles.
-								break;
+						if( m_Parallel ) {
+							threads.join(failed);
+							failed = pipeline.failed;
+							if( !error ) {
+								error = pipeline.error;
 							}
-							image->setOffset(0, 0);
-
-							if( rowsLeftOver > 0 ) {
-								// Copy the bottom of this tile to the top of the image, so it serves as the filter edge padding  for the next resize.
-								sourceImage->setDimensions(readWidth, maxSourceHeight);
-								sourceImage->copyRect(sourceImage, 0, prevTileOverlap + rowsProcessed - tileOverlap, 0, 0, readWidth, rowsLeftOver + tileOverlap);
-								sourceImage->setDimensions(readWidth, rowsLeftOver + tileOverlap);
-								prevTileUnprocessed = rowsLeftOver;
-								prevTileOverlap = tileOverlap;
-							} else {
-								prevTileUnprocessed = 0;
-								prevTileOverlap = 0;
-							}
-
-							currentInRow += rowsProcessed;
-							currentOutRow += effectiveOutRows;
-							rowsOutRemaining -= effectiveOutRows;
-							rowsInRemaining -= rowsToRead;
 						}
 
 						if( !failed ) {
@@ -255,9 +464,13 @@ int TiledResizeOperation::performResize()
 						}
 					}
 
-					delete destImage1;
-					delete destImage2;
-					delete sourceImage;
+					for( unsigned int i = 0; i < pipeline.numTiles; i++ ) {
+						delete pipeline.tiles[i].destImage1;
+						delete pipeline.tiles[i].destImage2;
+						delete pipeline.tiles[i].sourceImage;
+						delete pipeline.tiles[i].filterKernelY;
+					}
+					delete overlapImage;
 				}
 			}
 		}
@@ -266,6 +479,10 @@ int TiledResizeOperation::performResize()
 		delete filterKernelY;
 	}
 
+	if( error ) {
+		std::rethrow_exception(error);
+	}
+
 	return success ? IMAGECORE_SUCCESS : IMAGECORE_UNKNOWN_ERROR;
 }
 
@@ -38,6 +38,13 @@ public:
 		m_ResizeQuality = quality;
 	}
 
+	// Pipelines the tiles: the filter pass of a tile runs on a worker thread while the next tile is read
+	// and the previous one is written on another. Reading and writing stay sequential.
+	void setParallel(bool parallel)
+	{
+		m_Parallel = parallel;
+	}
+
 	int performResize();
 
 private:
@@ -46,6 +53,7 @@ private:
 	unsigned int m_OutputWidth;
 	unsigned int m_OutputHeight;
 	EResizeQuality m_ResizeQuality;
+	bool m_Parallel;
 };
 
 }
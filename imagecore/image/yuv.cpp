@@ -125,6 +125,22 @@ bool ImageYUV::resize(Image* dest, EResizeQuality quality)
 	return false;
 }
 
+bool ImageYUV::resize(Image* dest, EResizeQuality quality, EImageOrientation orientation)
+{
+	ImageYUV* destYUV = dest->asYUV();
+	if( destYUV ) {
+		if( m_PlaneY->resize(destYUV->getPlaneY(), quality, orientation) ) {
+			if( m_PlaneU->resize(destYUV->getPlaneU(), quality, orientation) ) {
+				if( m_PlaneV->resize(destYUV->getPlaneV(), quality, orientation) ) {
+					destYUV->setRange(m_Range);
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
 void ImageYUV::reduceHalf(Image* dest)
 {
 	ImageYUV* destYUV = dest->asYUV();
@@ -289,6 +305,28 @@ void ImageYUV::expandRange(ImageYUV *destImage)
 	destImage->setRange(kYUVRange_Full);
 }
 
+void ImageYUV::convertRange(ImageYUV* destImage, EYUVRange range)
+{
+	SECURE_ASSERT(range != kYUVRange_Unknown);
+	ImagePlane8* planes[] = { m_PlaneY, m_PlaneU, m_PlaneV };
+	ImagePlane8* destPlanes[] = { destImage->m_PlaneY, destImage->m_PlaneU, destImage->m_PlaneV };
+	for( unsigned int i = 0; i < 3; i++ ) {
+		unsigned int width = planes[i]->getWidth();
+		unsigned int height = planes[i]->getHeight();
+		SECURE_ASSERT(destPlanes[i]->getWidth() == width && destPlanes[i]->getHeight() == height);
+		unsigned int pitch;
+		unsigned int destPitch;
+		const uint8_t* buffer = planes[i]->lockRect(width, height, pitch);
+		uint8_t* destBuffer = destPlanes[i]->lockRect(width, height, destPitch);
+#if __SSE4_1__ || __ARM_NEON__
+		Conversions<true>::yuv_range(destBuffer, buffer, width, height, pitch, destPitch, range == kYUVRange_Full, i != 0);
+#else
+		Conversions<false>::yuv_range(destBuffer, buffer, width, height, pitch, destPitch, range == kYUVRange_Full, i != 0);
+#endif
+	}
+	destImage->setRange(range);
+}
+
 EYUVRange ImageYUV::getRange()
 {
 	return m_Range;
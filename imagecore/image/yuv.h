@@ -49,6 +49,8 @@ public:
 	virtual void setPadding(unsigned int padding);
 
 	virtual bool resize(Image* dest, EResizeQuality quality);
+	// Resizes every plane into the rotated dest, see ImagePlane::resize.
+	bool resize(Image* dest, EResizeQuality quality, EImageOrientation orientation);
 	virtual void reduceHalf(Image* dest);
 	virtual bool crop(const ImageRegion& boundingBox);
 	virtual void rotate(Image* dest, EImageOrientation direction);
@@ -66,6 +68,9 @@ public:
 	// YUV
 	virtual void expandRange(ImageYUV* destImage);
 	virtual void compressRange(ImageYUV* destImage);
+	// Converts every plane to the given range with the integer BT.601 formula (SIMD when available),
+	// destImage planes must have the same dimensions as the planes of this image and can be this image.
+	virtual void convertRange(ImageYUV* destImage, EYUVRange range);
 	virtual EYUVRange getRange();
 	virtual void setRange(EYUVRange range);
 
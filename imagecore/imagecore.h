@@ -48,6 +48,10 @@ typedef void (*ImageCoreAssertionHandler)(int code, const char* message, const c
 IMAGECORE_EXPORT void ImageCoreAssert(int code, const char* message, const char* file, int line);
 IMAGECORE_EXPORT void RegisterImageCoreAssertionHandler(ImageCoreAssertionHandler handler);
 
+// Threads each filter pass may be split across, including the calling one. 1 by default, 0 uses all cores.
+IMAGECORE_EXPORT void ImageCoreSetThreadCount(unsigned int threadCount);
+IMAGECORE_EXPORT unsigned int ImageCoreGetThreadCount();
+
 #define ASSERT(x) { if( !(x) ) { ImageCoreAssert(IMAGECORE_ASSERTION_FAILED,  #x, __FILE__, __LINE__); } }
 // Never disable this assertion macro, most of the security checks in the program are wrapped with this.
 #define SECURE_ASSERT(x) { if( !(x) ) { ImageCoreAssert(IMAGECORE_SECURITY_ASSERTION, #x, __FILE__, __LINE__); } }
@@ -22,21 +22,41 @@
  * SOFTWARE.
  */
 
+#include <atomic>
+#include <chrono>
 #include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "reader.h"
+#include "vireo/constants.h"
 
 namespace vireo {
 namespace common {
 
 using namespace std;
 
+#ifndef ANDROID
+typedef common::Data64 Mapping;
+#else
+typedef common::Data32 Mapping;
+#endif
+
 struct _Reader {
   mutex lock;
-  uint32_t offset = 0;
-  const uint32_t size;
-  common::Data32 data;
-  std::function<common::Data32(const uint32_t offset, const uint32_t size)> read_func;
+  uint64_t offset = 0;
+  const uint64_t size;
+  std::function<common::Data32(const uint64_t offset, const uint32_t size)> read_func;
+  std::function<void(const uint64_t offset, const uint32_t size)> prefetch_func;
+  mutex prefetch_lock;
+  Reader::Prefetch prefetch;
+  struct {
+    atomic<uint64_t> reads { 0 };
+    atomic<uint64_t> bytes_read { 0 };
+    atomic<uint64_t> prefetches { 0 };
+    atomic<uint64_t> bytes_prefetched { 0 };
+    atomic<uint64_t> read_time_us { 0 };
+  } stats;
 
   // opaque, read_func, seek_func used to interface with l-smash and ffmpeg
   const void* opaque = (void*)this;
@@ -46,9 +66,9 @@ struct _Reader {
     if (reader.offset >= reader.size) {
       return 0;
     }
-    const uint32_t read_size = std::min((uint32_t)size, reader.size - reader.offset);
+    const uint32_t read_size = (uint32_t)std::min((uint64_t)size, reader.size - reader.offset);
     if (read_size) {
-      auto data = reader.read_func(reader.offset, read_size);
+      auto data = reader.read(reader.offset, read_size);
       CHECK(data.count() == read_size);
       memcpy(buffer, data.data(), read_size);
       reader.offset += read_size;
@@ -60,47 +80,147 @@ struct _Reader {
     lock_guard<mutex>(reader.lock);
     if (whence == SEEK_SET) {
       CHECK(offset >= 0);
-      reader.offset = (uint32_t)offset;
+      reader.offset = (uint64_t)offset;
     } else if (whence == SEEK_CUR) {
       CHECK((int64_t)reader.offset + offset >= 0);
-      reader.offset = (uint32_t)((int64_t)reader.offset + offset);
+      reader.offset = (uint64_t)((int64_t)reader.offset + offset);
     } else if (whence == SEEK_END) {
       CHECK((int64_t)reader.size + offset >= 0);
-      reader.offset = (uint32_t)((int64_t)reader.size + offset);
+      reader.offset = (uint64_t)((int64_t)reader.size + offset);
     }
-    return std::min(reader.offset, reader.size);
+    return (int64_t)std::min(reader.offset, reader.size);
   };
 
-  _Reader(common::Data32&& data) : data(move(data)), size(data.count()), read_func(
-    [data = &this->data](const uint32_t offset, const uint32_t size) -> common::Data32 {
-      THROW_IF(offset + size > data->count(), OutOfRange);
-      return common::Data32(data->data() + data->a() + offset, size, nullptr);
-    }) {}
-
-  _Reader(const uint32_t size, std::function<common::Data32(const uint32_t offset, const uint32_t size)> read_func) : size(size), read_func(read_func) {}
+  _Reader(const uint64_t size, std::function<common::Data32(const uint64_t offset, const uint32_t size)> read_func,
+          std::function<void(const uint64_t offset, const uint32_t size)> prefetch_func)
+    : size(size), read_func(read_func), prefetch_func(prefetch_func) {}
+
+  // Reads return views into data, which is kept alive by the reader
+  template <typename D>
+  static auto Hold(D&& data) -> shared_ptr<_Reader> {
+    const auto held = make_shared<D>(move(data));
+    return make_shared<_Reader>((uint64_t)held->count(), [held](const uint64_t offset, const uint32_t size) -> common::Data32 {
+      THROW_IF(offset + size > held->count(), OutOfRange);
+      // keep up to kSamplePaddingSize bytes past the requested range addressable, decoders that only over-read can skip staging copies;
+      // the slice shares ownership of the backing data so it stays valid after the reader is gone
+      common::Data32 slice(held->data() + held->a() + offset, (uint32_t)std::min((uint64_t)size + kSamplePaddingSize, (uint64_t)held->count() - offset), [held](uint8_t*) {});
+      slice.set_bounds(0, size);
+      return move(slice);
+    }, nullptr);
+  }
+
+  static auto Map(Mapping&& mapping) -> shared_ptr<_Reader> {
+    const uint8_t* bytes = mapping.data() + mapping.a();
+    auto reader = Hold(move(mapping));
+    // bytes is a file mapping starting on a page boundary, hints only so errors are ignored
+    reader->prefetch_func = [bytes](const uint64_t offset, const uint32_t size) {
+      const uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+      const uintptr_t start = (uintptr_t)(bytes + offset) & ~(page_size - 1);
+      const uintptr_t end = (uintptr_t)(bytes + offset + size);
+      madvise((void*)start, end - start, MADV_WILLNEED);
+    };
+    reader->prefetch = Reader::Sequential();
+    return reader;
+  }
+
+  auto read(const uint64_t offset, const uint32_t size) -> common::Data32 {
+    const auto start = chrono::steady_clock::now();
+    auto data = read_func(offset, size);
+    stats.read_time_us += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    stats.reads++;
+    stats.bytes_read += data.count();
+    readahead(offset, size);
+    return move(data);
+  }
+
+  auto readahead(const uint64_t offset, const uint32_t size) -> void {
+    if (!prefetch_func) {
+      return;
+    }
+    pair<uint64_t, uint32_t> range;
+    {
+      lock_guard<mutex> guard(prefetch_lock);  // strategies keep state across calls
+      if (!prefetch) {
+        return;
+      }
+      range = prefetch(offset, size);
+    }
+    if (range.first >= this->size) {
+      return;
+    }
+    range.second = (uint32_t)std::min((uint64_t)range.second, this->size - range.first);
+    if (range.second) {
+      prefetch_func(range.first, range.second);
+      stats.prefetches++;
+      stats.bytes_prefetched += range.second;
+    }
+  }
 };
 
-Reader::Reader(common::Data32&& data) : _this(make_shared<_Reader>(move(data))), opaque(_this->opaque), read_callback(_this->read_callback), seek_callback(_this->seek_callback) {
-  CHECK(_this->data.count());
+Reader::Reader(common::Data32&& data) : _this(_Reader::Hold(move(data))), opaque(_this->opaque), read_callback(_this->read_callback), seek_callback(_this->seek_callback) {
+  CHECK(_this->size);
 }
 
-Reader::Reader(int file_descriptor, std::function<void(int file_descriptor)> deleter) : Reader(common::Data32(file_descriptor, deleter)) {}
+Reader::Reader(int file_descriptor, std::function<void(int file_descriptor)> deleter)
+  : _this(_Reader::Map(Mapping(file_descriptor, deleter))), opaque(_this->opaque), read_callback(_this->read_callback), seek_callback(_this->seek_callback) {
+  CHECK(_this->size);
+}
 
-Reader::Reader(const std::string& path) : Reader(common::Data32(path)) {}
+Reader::Reader(const std::string& path)
+  : _this(_Reader::Map(Mapping(path))), opaque(_this->opaque), read_callback(_this->read_callback), seek_callback(_this->seek_callback) {
+  CHECK(_this->size);
+}
 
 Reader::Reader(Reader&& reader) : _this(reader._this), opaque(_this->opaque), read_callback(_this->read_callback), seek_callback(_this->seek_callback) {
   reader._this = nullptr;
 }
 
-Reader::Reader(const uint32_t size, std::function<common::Data32(const uint32_t offset, const uint32_t size)> read_func)
-  : _this(make_shared<_Reader>(size, read_func)), opaque(_this->opaque), read_callback(_this->read_callback), seek_callback(_this->seek_callback) {}
+Reader::Reader(const uint64_t size, std::function<common::Data32(const uint64_t offset, const uint32_t size)> read_func,
+               std::function<void(const uint64_t offset, const uint32_t size)> prefetch_func)
+  : _this(make_shared<_Reader>(size, read_func, prefetch_func)), opaque(_this->opaque), read_callback(_this->read_callback), seek_callback(_this->seek_callback) {
+  if (prefetch_func) {
+    _this->prefetch = Sequential();
+  }
+}
 
-auto Reader::read(uint32_t offset, uint32_t size) -> common::Data32 {
-  return _this->read_func(offset, size);
+auto Reader::read(uint64_t offset, uint32_t size) -> common::Data32 {
+  return _this->read(offset, size);
 }
 
-auto Reader::size() const -> uint32_t {
+auto Reader::size() const -> uint64_t {
   return _this->size;
 }
 
+auto Reader::set_prefetch(const Prefetch& prefetch) -> void {
+  lock_guard<mutex> guard(_this->prefetch_lock);
+  _this->prefetch = prefetch;
+}
+
+auto Reader::stats() const -> Stats {
+  Stats stats;
+  stats.reads = _this->stats.reads;
+  stats.bytes_read = _this->stats.bytes_read;
+  stats.prefetches = _this->stats.prefetches;
+  stats.bytes_prefetched = _this->stats.bytes_prefetched;
+  stats.read_time_us = _this->stats.read_time_us;
+  return stats;
+}
+
+auto Reader::Sequential(uint32_t window) -> Prefetch {
+  THROW_IF(!window, InvalidArguments);
+  auto prefetched = make_shared<uint64_t>(0);  // end of the range paged in so far
+  return [prefetched, window](const uint64_t offset, const uint32_t size) -> pair<uint64_t, uint32_t> {
+    const uint64_t end = offset + size;
+    if (offset > *prefetched || offset + 2 * window < *prefetched) {  // seek, start over from here
+      *prefetched = end;
+    }
+    if (end + window / 2 <= *prefetched) {  // still well within the range paged in
+      return { 0, 0 };
+    }
+    const uint64_t start = std::max(end, *prefetched);
+    *prefetched = end + window;
+    return { start, (uint32_t)(*prefetched - start) };
+  };
+}
+
 }}
\ No newline at end of file
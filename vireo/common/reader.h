@@ -26,6 +26,7 @@
 
 #include "vireo/base_h.h"
 #include "vireo/common/data.h"
+#include "vireo/constants.h"
 
 namespace vireo {
 namespace common {
@@ -35,13 +36,30 @@ using namespace std;
 class PUBLIC Reader final {
   std::shared_ptr<struct _Reader> _this = nullptr;
 public:
+  // Readahead strategy: called with the range of every read, returns the range that should be paged in next ({ 0, 0 } for none)
+  typedef std::function<pair<uint64_t, uint32_t>(const uint64_t offset, const uint32_t size)> Prefetch;
+  struct Stats {
+    uint64_t reads = 0;
+    uint64_t bytes_read = 0;
+    uint64_t prefetches = 0;
+    uint64_t bytes_prefetched = 0;
+    uint64_t read_time_us = 0;  // time spent in the read function, page faults on memory mapped readers happen later on first access
+  };
+
   Reader(common::Data32&& data);
-  Reader(int file_descriptor, std::function<void(int file_descriptor)> deleter = NULL);  // Memory mapped
-  Reader(const std::string& path);
+  Reader(int file_descriptor, std::function<void(int file_descriptor)> deleter = NULL);  // Memory mapped (past 4GB except on Android), reads ahead with Sequential()
+  Reader(const std::string& path);  // Memory mapped (past 4GB except on Android), reads ahead with Sequential()
   Reader(Reader&& reader);
-  Reader(const uint32_t size, std::function<common::Data32(const uint32_t offset, const uint32_t size)> read_func);
-  auto read(uint32_t offset, uint32_t size) -> common::Data32;
-  auto size() const -> uint32_t;
+  Reader(const uint64_t size, std::function<common::Data32(const uint64_t offset, const uint32_t size)> read_func,
+         std::function<void(const uint64_t offset, const uint32_t size)> prefetch_func = nullptr);  // prefetch_func receives the readahead hints, e.g. for posix_fadvise
+  auto read(uint64_t offset, uint32_t size) -> common::Data32;  // a single read is still limited to 4GB
+  auto size() const -> uint64_t;
+  auto set_prefetch(const Prefetch& prefetch) -> void;  // nullptr disables readahead
+  auto stats() const -> Stats;
+
+  // Pages in window bytes ahead of reads that move forward through the file, such as samples read in decode order,
+  // and starts over after a seek; tolerates the back and forth of interleaved tracks
+  static auto Sequential(uint32_t window = kReaderReadaheadSize) -> Prefetch;
   DISALLOW_COPY_AND_ASSIGN(Reader);
   const void* opaque;
   int(*const read_callback)(void*, uint8_t*, int);
@@ -0,0 +1,131 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "vireo/base_cpp.h"
+#include "vireo/common/rope.h"
+#include "vireo/error/error.h"
+
+namespace vireo {
+namespace common {
+
+struct _Rope {
+  const uint32_t block_size;
+  vector<unique_ptr<uint8_t[]>> blocks;
+  uint64_t position = 0;
+  uint64_t size = 0;
+  _Rope(uint32_t block_size) : block_size(block_size) {}
+
+  // Calls func(block, offset in block, length) for each piece of [offset, offset + size)
+  template <typename Func>
+  auto for_each(uint64_t offset, uint64_t size, const Func& func) const -> void {
+    while (size) {
+      const size_t block = (size_t)(offset / block_size);
+      const uint32_t block_offset = (uint32_t)(offset % block_size);
+      const uint32_t length = (uint32_t)std::min(size, (uint64_t)(block_size - block_offset));
+      func(blocks[block].get(), block_offset, length);
+      offset += length;
+      size -= length;
+    }
+  }
+};
+
+Rope::Rope(uint32_t block_size) : _this(new _Rope(block_size)) {
+  THROW_IF(!block_size, InvalidArguments);
+}
+
+Rope::Rope(Rope&& rope) : _this(rope._this) {
+  rope._this = nullptr;
+}
+
+auto Rope::write(const uint8_t* bytes, uint32_t size) -> void {
+  THROW_IF(!bytes && size, InvalidArguments);
+  const uint64_t end = _this->position + size;
+  while ((uint64_t)_this->blocks.size() * _this->block_size < end) {
+    _this->blocks.emplace_back(new uint8_t[_this->block_size]);
+  }
+  _this->for_each(_this->position, size, [&bytes](uint8_t* block, uint32_t offset, uint32_t length) {
+    memcpy(block + offset, bytes, length);
+    bytes += length;
+  });
+  _this->position += size;
+  _this->size = std::max(_this->size, _this->position);
+}
+
+auto Rope::read(uint8_t* bytes, uint32_t size) -> uint32_t {
+  const uint32_t read_size = (uint32_t)std::min((uint64_t)size, _this->size - _this->position);
+  THROW_IF(!bytes && read_size, InvalidArguments);
+  _this->for_each(_this->position, read_size, [&bytes](uint8_t* block, uint32_t offset, uint32_t length) {
+    memcpy(bytes, block + offset, length);
+    bytes += length;
+  });
+  _this->position += read_size;
+  return read_size;
+}
+
+auto Rope::seek(uint64_t position) -> void {
+  THROW_IF(position > _this->size, OutOfRange);
+  _this->position = position;
+}
+
+auto Rope::position() const -> uint64_t {
+  return _this->position;
+}
+
+auto Rope::size() const -> uint64_t {
+  return _this->size;
+}
+
+auto Rope::data(uint64_t offset, uint32_t size) const -> common::Data32 {
+  THROW_IF(offset > _this->size || size > _this->size - offset, OutOfRange);
+  common::Data32 data(new uint8_t[size], size, [](uint8_t* p) { delete[] p; });
+  uint8_t* bytes = (uint8_t*)data.data();
+  _this->for_each(offset, size, [&bytes](uint8_t* block, uint32_t offset, uint32_t length) {
+    memcpy(bytes, block + offset, length);
+    bytes += length;
+  });
+  return move(data);
+}
+
+auto Rope::data(uint64_t offset) const -> common::Data32 {
+  THROW_IF(offset > _this->size, OutOfRange);
+  THROW_IF(_this->size - offset > std::numeric_limits<uint32_t>::max(), Unsafe);  // use blocks()
+  return move(data(offset, (uint32_t)(_this->size - offset)));
+}
+
+auto Rope::blocks(uint64_t offset, uint64_t size) const -> vector<common::Data32> {
+  THROW_IF(offset > _this->size || size > _this->size - offset, OutOfRange);
+  vector<common::Data32> blocks;
+  const auto rope = _this;  // views keep the blocks alive, blocks are never freed or moved while the rope exists
+  _this->for_each(offset, size, [&blocks, &rope](uint8_t* block, uint32_t offset, uint32_t length) {
+    blocks.emplace_back(block + offset, length, [rope](uint8_t*) {});
+  });
+  return blocks;
+}
+
+auto Rope::blocks(uint64_t offset) const -> vector<common::Data32> {
+  THROW_IF(offset > _this->size, OutOfRange);
+  return blocks(offset, _this->size - offset);
+}
+
+}}
@@ -0,0 +1,53 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "vireo/base_h.h"
+#include "vireo/common/data.h"
+#include "vireo/constants.h"
+
+namespace vireo {
+namespace common {
+
+// Seekable output buffer made of fixed size blocks: growing never moves what is already written,
+// and contents can be handed out block by block (e.g. to writev) without being flattened first
+class PUBLIC Rope final {
+  std::shared_ptr<struct _Rope> _this = nullptr;
+public:
+  Rope(uint32_t block_size = kRopeBlockSize);
+  Rope(Rope&& rope);
+  DISALLOW_COPY_AND_ASSIGN(Rope);
+  auto write(const uint8_t* bytes, uint32_t size) -> void;  // at position, overwrites existing contents then grows
+  auto read(uint8_t* bytes, uint32_t size) -> uint32_t;  // from position, returns the number of bytes read
+  auto seek(uint64_t position) -> void;  // within [0, size()]
+  auto position() const -> uint64_t;
+  auto size() const -> uint64_t;  // not limited to 4GB, only single buffer copies are
+  auto data(uint64_t offset, uint32_t size) const -> common::Data32;  // copy of a range in a single buffer
+  auto data(uint64_t offset = 0) const -> common::Data32;  // copy of the contents from offset in a single buffer, throws Unsafe past 4GB
+  auto blocks(uint64_t offset, uint64_t size) const -> vector<common::Data32>;  // views of a range, they keep the blocks alive even past the rope, writing to the rope changes what they see
+  auto blocks(uint64_t offset = 0) const -> vector<common::Data32>;  // views of the contents from offset
+};
+
+}}
@@ -43,3 +43,19 @@ const static uint64_t kMicroSecondScale = 1000000;
 const static uint64_t kNanoSecondScale = 1000000000;
 
 const static uint32_t kMP2TSTimescale = 90000;  // default timescale for MPEG-TS
+
+const static uint32_t kSamplePaddingSize = 64;  // readable bytes kept past the end of a sample when the backing buffer allows, for decoders that over-read without needing zeroes (fdk-aac)
+
+const static uint32_t kReaderReadaheadSize = 0x400000;  // default window paged in ahead of sequential reads by common::Reader (4 MB)
+
+const static uint32_t kDecodeCacheSize = 0;  // default memory budget for decoded frames kept around for random access (off, it adds up across parallel decoders)
+
+const static uint64_t kFramePoolSize = 0x8000000;  // default memory budget for plane buffers kept around for reuse by frame::Pool (128 MB)
+
+const static uint32_t kPipelineQueueSize = 8;  // default number of items buffered between two stages of transform::Pipeline
+
+const static uint32_t kParallelTranscodeSegmentSize = 120;  // default minimum number of frames encoded by one worker of transform::ParallelTranscode
+
+const static uint32_t kLadderCacheSize = 128;  // default number of source frames kept scaled by encode::Ladder for renditions that have not pulled them yet
+
+const static uint32_t kRopeBlockSize = 0x80000;  // size of the blocks common::Rope grows by, muxers write their output into one (512 KB)
@@ -0,0 +1,112 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "vireo/base_cpp.h"
+#include "vireo/common/math.h"
+#include "vireo/common/security.h"
+#include "vireo/decode/thumbnails.h"
+#include "vireo/decode/video.h"
+#include "vireo/error/error.h"
+
+namespace vireo {
+namespace decode {
+
+struct _Thumbnails {
+  vector<uint32_t> indices;  // sorted keyframe indices in the original track, one per thumbnail
+  unique_ptr<Video> decoder;  // decodes the track made of only those keyframes
+  uint16_t width;
+};
+
+// halves with the box filter as long as it does not undershoot, the remaining (less than 2x) downscale is left to the resampler
+static auto downscale(const frame::YUV& yuv, uint16_t width) -> frame::YUV {
+  if (yuv.width() / 2 >= width && yuv.width() % 4 == 0 && yuv.height() % 4 == 0) {
+    return downscale(yuv.reduce_half(), width);
+  } else if (yuv.width() == width) {
+    return yuv;
+  } else {
+    return frame::YUV(yuv).scale(width, yuv.width());
+  }
+}
+
+Thumbnails::Thumbnails(const functional::Video<Sample>& track, uint32_t count, uint16_t width)
+  : functional::DirectVideo<Thumbnails, frame::Frame>(), _this(new _Thumbnails) {
+  THROW_IF(!count || count > security::kMaxSampleCount, InvalidArguments);
+  THROW_IF(!width, InvalidArguments);
+  THROW_IF(!track.count(), InvalidArguments);
+
+  vector<uint32_t> keyframes;
+  for (uint32_t index = track.a(); index < track.b(); ++index) {
+    if (track(index).keyframe) {
+      keyframes.push_back(index);
+    }
+  }
+  THROW_IF(keyframes.empty(), Invalid, "Video has no keyframes");
+
+  // snap evenly spaced indices to the closest keyframe
+  const uint32_t last = track.count() - 1;
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t target = track.a() + (count == 1 ? 0 : (uint32_t)common::round_divide((uint64_t)i, (uint64_t)last, (uint64_t)(count - 1)));
+    auto it = lower_bound(keyframes.begin(), keyframes.end(), target);
+    if (it == keyframes.end() || (it != keyframes.begin() && target - *(it - 1) <= *it - target)) {
+      --it;
+    }
+    if (_this->indices.empty() || _this->indices.back() != *it) {
+      _this->indices.push_back(*it);
+    }
+  }
+
+  auto keyframe_track = functional::Video<Sample>([track, indices = _this->indices](uint32_t index) {
+    return track(indices[index]);
+  }, 0, (uint32_t)_this->indices.size(), track.settings());
+  // keyframes are decoded independently, there is no reuse to cache for
+  _this->decoder.reset(new Video(keyframe_track, 0, 0, true));
+
+  _settings = _this->decoder->settings();
+  THROW_IF(!_settings.width || !_settings.height, Unsupported);
+  _this->width = std::min(width, _settings.width);
+  _settings.height = (uint16_t)std::max(common::round_divide((uint32_t)_settings.height, (uint32_t)_this->width, (uint32_t)_settings.width), (uint32_t)1);
+  _settings.width = _this->width;
+  set_bounds(0, (uint32_t)_this->indices.size());
+}
+
+Thumbnails::Thumbnails(const Thumbnails& thumbnails)
+  : functional::DirectVideo<Thumbnails, frame::Frame>(thumbnails.a(), thumbnails.b(), thumbnails.settings()), _this(thumbnails._this) {}
+
+auto Thumbnails::index(uint32_t index) const -> uint32_t {
+  THROW_IF(index >= count(), OutOfRange);
+  return _this->indices[index];
+}
+
+auto Thumbnails::operator()(uint32_t index) const -> frame::Frame {
+  THROW_IF(index >= count(), OutOfRange);
+  frame::Frame frame = (*_this->decoder)(index);
+  frame.yuv = [width = _this->width, yuv = frame.yuv]() -> frame::YUV {
+    return downscale(yuv(), width);
+  };
+  return frame;
+}
+
+}}
@@ -0,0 +1,47 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "vireo/base_h.h"
+#include "vireo/decode/types.h"
+#include "vireo/frame/frame.h"
+#include "vireo/functional/media.hpp"
+
+namespace vireo {
+namespace decode {
+
+// Evenly spaced thumbnails of a video track, each snapped to the nearest keyframe so that only keyframes are decoded
+// Frames are downscaled to the requested width (aspect ratio is preserved), duplicates are dropped so count() can be lower than requested
+class PUBLIC Thumbnails final : public functional::DirectVideo<Thumbnails, frame::Frame> {
+  std::shared_ptr<struct _Thumbnails> _this;
+public:
+  Thumbnails(const functional::Video<Sample>& track, uint32_t count, uint16_t width);
+  Thumbnails(const Thumbnails& thumbnails);
+  DISALLOW_ASSIGN(Thumbnails);
+  auto index(uint32_t index) const -> uint32_t;  // sample index in the original track
+  auto operator()(uint32_t index) const -> frame::Frame;
+};
+
+}}
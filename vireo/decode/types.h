@@ -39,14 +39,14 @@ namespace decode {
 struct ByteRange {
   ByteRange() : available(false), pos(0), size(0) {}
   ByteRange(const ByteRange& byte_range) : available(byte_range.available), pos(byte_range.pos), size(byte_range.size) {}
-  ByteRange(uint32_t pos, uint32_t size) : available(true), pos(pos), size(size) {}
+  ByteRange(uint64_t pos, uint32_t size) : available(true), pos(pos), size(size) {}
   bool available;
-  uint32_t pos;
+  uint64_t pos;
   uint32_t size;
 };
 
 struct Sample {
-  Sample(int64_t pts, int64_t dts, bool keyframe, SampleType type, const std::function<common::Data32(void)>& nal, uint32_t pos, uint32_t size)
+  Sample(int64_t pts, int64_t dts, bool keyframe, SampleType type, const std::function<common::Data32(void)>& nal, uint64_t pos, uint32_t size)
     : pts(pts), dts(dts), keyframe(keyframe), type(type), nal(nal), byte_range(ByteRange(pos, size)) {}
   Sample(int64_t pts, int64_t dts, bool keyframe, SampleType type, const std::function<common::Data32(void)>& nal)
     : pts(pts), dts(dts), keyframe(keyframe), type(type), nal(nal) {}
@@ -40,21 +40,21 @@ struct _Video {
   functional::Video<frame::Frame> track;
 
   template<settings::Video::Codec codec, typename std::enable_if<codec == settings::Video::Codec::H264 && has_video_decoder<codec>::value>::type* = nullptr>
-  void process(const functional::Video<Sample>& video_track, uint32_t thread_count) {
-    track = internal::decode::H264(move(video_track), thread_count);
+  void process(const functional::Video<Sample>& video_track, uint32_t thread_count, uint32_t cache_size, bool fast) {
+    track = internal::decode::H264(move(video_track), thread_count, cache_size, fast);
   }
   template<settings::Video::Codec codec, typename std::enable_if<codec == settings::Video::Codec::H264 && !has_video_decoder<codec>::value>::type* = nullptr>
-  void process(const functional::Video<Sample>& video_track, uint32_t thread_count) {
+  void process(const functional::Video<Sample>& video_track, uint32_t thread_count, uint32_t cache_size, bool fast) {
     THROW_IF(true, MissingDependency);
   }
 };
 
-Video::Video(const functional::Video<Sample>& track, uint32_t thread_count) : functional::DirectVideo<Video, frame::Frame>(), _this(new _Video) {
+Video::Video(const functional::Video<Sample>& track, uint32_t thread_count, uint32_t cache_size, bool fast) : functional::DirectVideo<Video, frame::Frame>(), _this(new _Video) {
   const auto& settings = track.settings();
   THROW_IF(settings.codec != settings::Video::Codec::H264 && !settings::Video::IsImage(settings.codec), Unsupported);
   THROW_IF(!track(0).keyframe, Invalid, "Video has to start with a keyframe");
   if (settings.codec == settings::Video::Codec::H264) {
-    _this->process<settings::Video::Codec::H264>(track, thread_count);
+    _this->process<settings::Video::Codec::H264>(track, thread_count, cache_size, fast);
   } else {
     _this->track = functional::Video<frame::Frame>(internal::decode::Image(move(track)));
   }
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "vireo/base_h.h"
+#include "vireo/constants.h"
 #include "vireo/decode/types.h"
 #include "vireo/frame/frame.h"
 #include "vireo/functional/media.hpp"
@@ -35,7 +36,9 @@ namespace decode {
 class PUBLIC Video final : public functional::DirectVideo<Video, frame::Frame> {
   std::shared_ptr<struct _Video> _this;
 public:
-  Video(const functional::Video<Sample>& track, uint32_t thread_count = 0);
+  // cache_size: memory budget in bytes for decoded frames kept around for random access, 0 (default) disables the cache
+  // fast: skips H.264 in-loop filtering, frames are meant for previews and thumbnails rather than further encoding
+  Video(const functional::Video<Sample>& track, uint32_t thread_count = 0, uint32_t cache_size = kDecodeCacheSize, bool fast = false);
   Video(const Video& video);
   DISALLOW_ASSIGN(Video);
   auto operator()(uint32_t index) const -> frame::Frame;
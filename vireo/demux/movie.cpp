@@ -91,8 +91,12 @@ struct _Movie {
 
   template <FileType Ftyp, typename std::enable_if<Ftyp == FileType::MP4>::type* = nullptr>
   void parse(common::Reader&& reader) {
+    parse_mp4(new internal::demux::MP4(move(reader)));
+  }
+
+  void parse_mp4(internal::demux::MP4* decoder) {
     file_type = FileType::MP4;
-    mp4_decoder.reset(new internal::demux::MP4(move(reader)));
+    mp4_decoder.reset(decoder);
     video.track = functional::Video<decode::Sample>(mp4_decoder->video_track);
     video.duration = mp4_decoder->video_track.duration();
     video.edit_boxes.insert(video.edit_boxes.end(),
@@ -170,7 +174,15 @@ Movie::Movie(common::Reader&& reader) : _this(make_shared<_Movie>()), audio_trac
   } else {
     _this->parse<FileType::MP4>(move(reader));
   }
+  init_tracks();
+}
+
+Movie::Movie(common::Reader&& reader, const common::Data32& index) : _this(make_shared<_Movie>()), audio_track(_this), video_track(_this), data_track(_this), caption_track(_this) {
+  _this->parse_mp4(new internal::demux::MP4(move(reader), index));
+  init_tracks();
+}
 
+auto Movie::init_tracks() -> void {
   video_track.set_bounds(_this->video.track.a(), _this->video.track.b());
   video_track._settings = _this->video.track.settings();
   _this->video.enforce_unique_pts_dts();
@@ -194,6 +206,26 @@ auto Movie::file_type() -> FileType {
   return _this->file_type;
 }
 
+auto Movie::index() const -> common::Data32 {
+  THROW_IF(_this->file_type != FileType::MP4, Unsupported, "sample index is only available for MP4");
+  return _this->mp4_decoder->index();
+}
+
+auto Movie::io_stats() const -> common::Reader::Stats {
+  switch (_this->file_type) {
+    case FileType::MP4:
+      return _this->mp4_decoder->io_stats();
+    case FileType::MP2TS:
+      return _this->mp2ts_decoder->io_stats();
+    case FileType::WebM:
+      return _this->webm_decoder->io_stats();
+    case FileType::Image:
+      return _this->image_decoder->io_stats();
+    default:
+      THROW_IF(true, Uninitialized);
+  }
+}
+
 Movie::VideoTrack::VideoTrack(const std::shared_ptr<_Movie>& _this) : _this(_this) {}
 
 Movie::VideoTrack::VideoTrack(const VideoTrack& video_track)
@@ -37,9 +37,12 @@ class PUBLIC Movie final {
   std::shared_ptr<struct _Movie> _this;
 public:
   Movie(common::Reader&& reader);
+  Movie(common::Reader&& reader, const common::Data32& index);  // skips parsing, index has to come from index() on the same file
   Movie(Movie&& movie);
   DISALLOW_COPY_AND_ASSIGN(Movie);
   auto file_type() -> FileType;
+  auto index() const -> common::Data32;  // compact binary sample index (MP4 only), store it next to the file to reopen it faster
+  auto io_stats() const -> common::Reader::Stats;  // I/O issued through the reader so far, including readahead
 
   class PUBLIC VideoTrack final : public functional::DirectVideo<VideoTrack, decode::Sample> {
     std::shared_ptr<_Movie> _this;
@@ -87,6 +90,9 @@ public:
     auto edit_boxes() const -> const vector<common::EditBox>&;
     auto operator()(const uint32_t index) const -> decode::Sample;
   } caption_track;
+
+private:
+  auto init_tracks() -> void;
 };
 
 }}
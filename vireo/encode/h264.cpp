@@ -22,10 +22,16 @@
  * SOFTWARE.
  */
 
+#include <chrono>
+#include <mutex>
+#include <unistd.h>
+
 #include "vireo/base_cpp.h"
+#include "vireo/common/path.h"
 #include "vireo/common/security.h"
 #include "vireo/encode/h264.h"
 #include "vireo/error/error.h"
+#include "vireo/util/util.h"
 extern "C" {
 #include "x264.h"
 }
@@ -52,12 +58,70 @@ using common::Data16;
 
 namespace encode {
 
+// x264 only reads and writes dual-pass statistics through files, they are kept in a private directory, by default memory backed
+class StatsDirectory {
+  string path;
+public:
+  StatsDirectory(const string& parent) {
+    THROW_IF(parent.empty() && !common::Path::Exists("/dev/shm"), InvalidArguments, "no /dev/shm for dual-pass statistics, a stats_dir is required");
+    const string dir = parent.empty() ? "/dev/shm" : parent;
+    string name = dir + "/vireo_h264_XXXXXX";
+    THROW_IF(!mkdtemp((char*)name.c_str()), InvalidArguments, "cannot create a directory for dual-pass statistics in " << dir);
+    path = name;
+  }
+  DISALLOW_COPY_AND_ASSIGN(StatsDirectory);
+  ~StatsDirectory() {
+    for (const auto& file: { stats(), mbtree(), stats() + ".temp", mbtree() + ".temp" }) {  // .temp while x264 writes them
+      remove(file.c_str());
+    }
+    rmdir(path.c_str());
+  }
+  auto stats() const -> string { return path + "/pass"; }
+  auto mbtree() const -> string { return stats() + ".mbtree"; }  // named by x264 after the statistics
+};
+
 struct _H264 {
+  shared_ptr<StatsDirectory> stats_dir;  // of a second pass, removed once the encoder is closed
   unique_ptr<x264_t, decltype(&x264_encoder_close)> encoder = { NULL, [](x264_t* encoder) { if (encoder) x264_encoder_close(encoder); } };
   functional::Video<frame::Frame> frames;
   uint32_t num_cached_frames = 0;
   uint32_t num_threads = 0;
   uint32_t max_delay = 0;
+  uint32_t fixed_keyint = 0;
+  vector<uint32_t> keyframes;
+  uint64_t frame_budget_us = 0;
+  uint32_t subpel_refine = 0;
+  uint32_t max_subpel_refine = 0;
+  uint32_t frames_within_budget = 0;
+  std::mutex stats_lock;
+  H264::Stats stats;
+  auto pace(uint64_t encode_time_us) -> bool {  // returns true if over budget
+    if (!frame_budget_us) {
+      return false;
+    }
+    const bool late = encode_time_us > frame_budget_us;
+    uint32_t target = subpel_refine;
+    if (late) {
+      frames_within_budget = 0;
+      target = subpel_refine > 1 ? subpel_refine - 1 : subpel_refine;
+    } else if (encode_time_us < frame_budget_us / 2 && subpel_refine < max_subpel_refine) {
+      if (++frames_within_budget >= kH264PacingRecoveryFrames) {
+        frames_within_budget = 0;
+        target = subpel_refine + 1;
+      }
+    } else {
+      frames_within_budget = 0;
+    }
+    if (target != subpel_refine) {
+      x264_param_t param;
+      x264_encoder_parameters(encoder.get(), &param);
+      param.analyse.i_subpel_refine = target;
+      if (x264_encoder_reconfig(encoder.get(), &param) == 0) {  // applied from the next frame on
+        subpel_refine = target;
+      }
+    }
+    return late;
+  }
   static inline const char* const GetProfile(VideoProfileType profile) {
     THROW_IF(profile != VideoProfileType::Baseline && profile != VideoProfileType::Main && profile != VideoProfileType::High, Unsupported, "unsupported profile type");
     switch (profile) {
@@ -85,6 +149,8 @@ H264::H264(const functional::Video<frame::Frame>& frames, const H264Params& para
   THROW_IF(params.computation.thread_count < kH264MinThreadCount || params.computation.thread_count > kH264MaxThreadCount, InvalidArguments);
   THROW_IF(!security::valid_dimensions(frames.settings().width, frames.settings().height), Unsafe);
   THROW_IF(frames.settings().par_width != frames.settings().par_height, InvalidArguments);
+  THROW_IF(params.gop.fixed_keyframes && (params.gop.keyint_max == 0 || params.gop.keyint_max == kDefaultH264KeyintMax), InvalidArguments, "fixed keyframes require keyint_max");
+  THROW_IF(!std::is_sorted(params.gop.keyframes.begin(), params.gop.keyframes.end()), InvalidArguments, "keyframes have to be sorted");
 
   x264_param_t param;
   {  // Params
@@ -164,11 +230,36 @@ H264::H264(const functional::Video<frame::Frame>& frames, const H264Params& para
         break;
     }
 
+    if (params.gop.fixed_keyframes) {
+      param.i_keyint_max = params.gop.keyint_max;
+      param.i_scenecut_threshold = 0;
+    }
+
+    if (params.latency.low_latency) {
+      param.rc.i_lookahead = 0;
+      param.i_sync_lookahead = 0;
+      param.i_bframe = 0;
+      param.rc.b_mb_tree = 0;
+      param.b_sliced_threads = 1;
+    }
+    if (params.latency.intra_refresh) {
+      THROW_IF(params.gop.fixed_keyframes, InvalidArguments, "intra refresh does not use keyframes");
+      param.b_intra_refresh = 1;
+      if (params.gop.keyint_max != kDefaultH264KeyintMax) {  // refresh period
+        param.i_keyint_max = params.gop.keyint_max;
+      }
+    }
+
     THROW_IF(x264_param_apply_profile(&param, _H264::GetProfile(params.profile)) < 0, InvalidArguments);
   }
   _this->frames = frames;
   _this->num_threads = params.computation.thread_count;
-  _this->max_delay = params.computation.thread_count + params.rc.look_ahead + params.gop.num_bframes;
+  _this->max_delay = params.latency.low_latency ? params.computation.thread_count : params.computation.thread_count + params.rc.look_ahead + params.gop.num_bframes;
+  _this->fixed_keyint = params.gop.fixed_keyframes ? params.gop.keyint_max : 0;
+  _this->keyframes = params.gop.keyframes;
+  _this->frame_budget_us = (uint64_t)params.latency.frame_budget_ms * 1000;
+  _this->subpel_refine = _this->max_subpel_refine = param.analyse.i_subpel_refine;
+  _this->stats.subpel_refine = _this->subpel_refine;
   {  // Encoder
     _this->encoder.reset(x264_encoder_open(&param));
     CHECK(_this->encoder);
@@ -200,6 +291,14 @@ auto H264::operator()(uint32_t index) const -> Sample {
   int i_nals;
   x264_picture_t out_picture;
   int video_size = 0;
+  uint32_t frames_in = 0;
+  uint64_t encode_time_us = 0;
+  auto encode = [_this = _this, &nals, &i_nals, &out_picture, &encode_time_us](x264_picture_t* in_picture) -> int {
+    const auto start = std::chrono::steady_clock::now();
+    const int size = x264_encoder_encode(_this->encoder.get(), &nals, &i_nals, in_picture, &out_picture);
+    encode_time_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    return size;
+  };
   auto has_more_frames_to_encode = [_this = _this, &index]() -> bool {
     return index + _this->num_cached_frames < _this->frames.count();
   };
@@ -208,10 +307,18 @@ auto H264::operator()(uint32_t index) const -> Sample {
       const frame::Frame frame = _this->frames(index + _this->num_cached_frames);
       const uint64_t pts = frame.pts;
       const frame::YUV yuv = frame.yuv();
+      // planes are handed over as is (e.g. decoder buffers), x264 reads i_width x i_height pixels out of them
+      THROW_IF(yuv.uv_ratio().first != 2 || yuv.uv_ratio().second != 2, Unsupported);
+      THROW_IF(yuv.width() < _settings.width || yuv.height() < _settings.height, InvalidArguments);
 
       x264_picture_t in_picture;
       x264_picture_init(&in_picture);
       in_picture.i_pts = pts;
+      const uint32_t frame_index = index + _this->num_cached_frames;
+      if ((_this->fixed_keyint && frame_index % _this->fixed_keyint == 0) ||
+          std::binary_search(_this->keyframes.begin(), _this->keyframes.end(), frame_index)) {
+        in_picture.i_type = X264_TYPE_IDR;
+      }
 
       in_picture.img.i_csp = X264_CSP;
       in_picture.img.i_plane = 3;
@@ -221,7 +328,10 @@ auto H264::operator()(uint32_t index) const -> Sample {
       in_picture.img.i_stride[0] = (int)yuv.plane(frame::Y).row();
       in_picture.img.i_stride[1] = (int)yuv.plane(frame::U).row();
       in_picture.img.i_stride[2] = (int)yuv.plane(frame::V).row();
-      video_size = x264_encoder_encode(_this->encoder.get(), &nals, &i_nals, &in_picture, &out_picture);
+      // x264 copies the picture into its own frame pool before returning, frames held back for lookahead / B-frames
+      // never refer to yuv, so it is released right after
+      video_size = encode(&in_picture);
+      frames_in++;
       _this->num_cached_frames += (video_size == 0);
       THROW_IF(_this->num_cached_frames > _this->max_delay, Unsupported);
     }
@@ -231,7 +341,7 @@ auto H264::operator()(uint32_t index) const -> Sample {
     uint32_t thread = 0;
     while (video_size == 0 && (_this->num_threads == 0 || thread < _this->num_threads)) {
       CHECK(thread < kH264MaxThreadCount);
-      video_size = x264_encoder_encode(_this->encoder.get(), &nals, &i_nals, nullptr, &out_picture); // flush out cached frames
+      video_size = encode(nullptr); // flush out cached frames
       thread++;
     }
     _this->num_cached_frames--;
@@ -240,6 +350,24 @@ auto H264::operator()(uint32_t index) const -> Sample {
   CHECK(nals);
   CHECK(i_nals != 0);
   CHECK(out_picture.i_pts >= 0);
+  {
+    const bool late = _this->pace(encode_time_us);
+    const uint32_t queue_depth = x264_encoder_delayed_frames(_this->encoder.get());
+    std::lock_guard<std::mutex> guard(_this->stats_lock);
+    H264::Stats& stats = _this->stats;
+    stats.frames += frames_in;
+    stats.samples++;
+    stats.queue_depth = queue_depth;
+    stats.max_queue_depth = max(stats.max_queue_depth, queue_depth);
+    stats.encode_time_us = encode_time_us;
+    stats.max_encode_time_us = max(stats.max_encode_time_us, encode_time_us);
+    stats.total_encode_time_us += encode_time_us;
+    stats.sample_bits = (uint32_t)video_size * 8;
+    stats.total_bits += stats.sample_bits;
+    stats.late_frames += late;
+    stats.subpel_refine = _this->subpel_refine;
+  }
+  // nals point into x264's output buffer which is reused by the next call, the sample owns a copy
   const auto video_nal = common::Data32(nals[0].p_payload, video_size, NULL);
   if (out_picture.b_keyframe) {
     common::Data16 sps_pps_data = _settings.sps_pps.as_extradata(header::SPS_PPS::ExtraDataType::avcc);
@@ -250,10 +378,108 @@ auto H264::operator()(uint32_t index) const -> Sample {
     video_sample_data.set_bounds(video_sample_data.a() + sps_pps_size, video_sample_data_size);
     video_sample_data.copy(video_nal);
     video_sample_data.set_bounds(0, video_sample_data_size);
-    return Sample(out_picture.i_pts,  out_picture.i_dts, (bool)out_picture.b_keyframe, SampleType::Video, video_sample_data);
+    Sample sample(out_picture.i_pts,  out_picture.i_dts, (bool)out_picture.b_keyframe, SampleType::Video, common::Data32());
+    sample.nal = move(video_sample_data);  // already a copy, avoid a second one
+    return sample;
   } else {
     return Sample(out_picture.i_pts,  out_picture.i_dts, (bool)out_picture.b_keyframe, SampleType::Video, video_nal);
   }
 }
 
-}}
\ No newline at end of file
+auto H264::stats() const -> Stats {
+  std::lock_guard<std::mutex> guard(_this->stats_lock);
+  return _this->stats;
+}
+
+struct TwoPassStats {
+  common::Data32 stats;
+  common::Data32 mbtree;  // empty without mb-tree rate control
+};
+
+static auto ReadStats(const StatsDirectory& dir) -> TwoPassStats {
+  TwoPassStats stats;
+  THROW_IF(!common::Path::Exists(dir.stats()), Invalid, "first pass did not write its statistics");
+  const common::Data32 mapped_stats(dir.stats());
+  stats.stats = mapped_stats;  // copies out of the mapping, the files are removed next
+  if (common::Path::Exists(dir.mbtree())) {
+    const common::Data32 mapped_mbtree(dir.mbtree());
+    stats.mbtree = mapped_mbtree;
+  }
+  return stats;
+}
+
+static auto WriteStats(const StatsDirectory& dir, const TwoPassStats& stats) -> void {
+  util::save(dir.stats(), stats.stats);
+  if (stats.mbtree.count()) {
+    util::save(dir.mbtree(), stats.mbtree);
+  }
+}
+
+auto H264::TwoPass(const functional::Video<frame::Frame>& frames, const H264Params& params, uint32_t cache_frames, const string& stats_dir) -> H264 {
+  THROW_IF(params.rc.rc_method != RCMethod::ABR && params.rc.rc_method != RCMethod::CBR, InvalidArguments, "dual-pass encoding requires a target bitrate");
+  THROW_IF(!params.rc.bitrate, InvalidArguments);
+  THROW_IF(!frames.count(), InvalidArguments);
+
+  auto cache = make_shared<vector<unique_ptr<frame::YUV>>>(min(cache_frames, frames.count()));
+  functional::Video<frame::Frame> first_pass_frames([frames, cache](uint32_t index) -> frame::Frame {
+    frame::Frame frame = frames(index);
+    if (index - frames.a() < cache->size()) {
+      frame.yuv = [yuv = frame.yuv, cache, index, a = frames.a()]() -> frame::YUV {
+        const frame::YUV decoded = yuv();
+        (*cache)[index - a].reset(new frame::YUV(decoded));
+        return decoded;
+      };
+    }
+    return frame;
+  }, frames.a(), frames.b(), frames.settings());
+
+  // Same GOP structure as the second pass, x264 rejects statistics that do not match it, with the analysis
+  // lowered like x264's fast first pass
+  H264Params first_pass_params = params;
+  first_pass_params.rc.is_second_pass = false;
+  first_pass_params.rc.subpel_refine = min(params.rc.subpel_refine, (uint32_t)2);
+  first_pass_params.rc.trellis = 0;
+  first_pass_params.rc.me_method = MotionEstimationMethod::Diamond;
+  first_pass_params.rc.mixed_refs = false;
+  first_pass_params.gop.frame_references = 1;
+
+  TwoPassStats stats;
+  {
+    StatsDirectory dir(stats_dir);
+    first_pass_params.rc.stats_log_path = dir.stats();
+    {
+      H264 first_pass(first_pass_frames, first_pass_params);
+      for (uint32_t index = 0; index < first_pass.count(); ++index) {
+        first_pass(index);
+      }
+    }  // x264 completes the statistics when the encoder is closed
+    stats = ReadStats(dir);
+  }
+
+  functional::Video<frame::Frame> second_pass_frames = frames;
+  if (!cache->empty()) {
+    second_pass_frames = functional::Video<frame::Frame>([frames, cache](uint32_t index) -> frame::Frame {
+      frame::Frame frame = frames(index);
+      if (index - frames.a() >= cache->size()) {
+        return frame;
+      }
+      auto& cached = (*cache)[index - frames.a()];
+      if (cached) {
+        const frame::YUV yuv = *cached;
+        cached.reset();
+        frame.yuv = [yuv]() -> frame::YUV { return yuv; };
+      }
+      return frame;
+    }, frames.a(), frames.b(), frames.settings());
+  }
+  H264Params second_pass_params = params;
+  second_pass_params.rc.is_second_pass = true;
+  auto dir = make_shared<StatsDirectory>(stats_dir);
+  WriteStats(*dir, stats);
+  second_pass_params.rc.stats_log_path = dir->stats();
+  H264 second_pass(second_pass_frames, second_pass_params);
+  second_pass._this->stats_dir = dir;  // x264 reads the mb-tree statistics as it encodes
+  return second_pass;
+}
+
+}}
@@ -24,6 +24,8 @@
 
 #pragma once
 
+#include <algorithm>
+
 #include "vireo/base_h.h"
 #include "vireo/common/data.h"
 #include "vireo/domain/interval.hpp"
@@ -42,6 +44,7 @@ static const int kH264MinThreadCount = 0;
 static const int kH264MaxThreadCount = 64;
 static const int kDefaultH264KeyintMax = 1 << 30;
 static const int kDefaultH264KeyintMin = 0;
+static const int kH264PacingRecoveryFrames = 30;  // consecutive frames well within budget before pacing restores analysis quality
 
 enum RCMethod {
   CRF = 0,
@@ -156,14 +159,32 @@ struct H264Params {
     uint32_t keyint_max; // maximum key frame interval
     uint32_t keyint_min;
     uint32_t frame_references;
+    bool fixed_keyframes; // IDR frames exactly every keyint_max frames and nowhere else (no scene cut detection), e.g. to align renditions
+    vector<uint32_t> keyframes; // sorted frame indices forced to be IDR frames, on top of the encoder's own decisions
     GopParams(int32_t num_bframes = -1,
               PyramidMode mode = PyramidMode::Normal,
               uint32_t keyint_max = kDefaultH264KeyintMax,
               uint32_t keyint_min = kDefaultH264KeyintMin,
-              uint32_t frame_references = 3)
-      : num_bframes(num_bframes), pyramid_mode(mode), keyint_max(keyint_max), keyint_min(keyint_min), frame_references(frame_references) {};
+              uint32_t frame_references = 3,
+              bool fixed_keyframes = false,
+              const vector<uint32_t>& keyframes = vector<uint32_t>())
+      : num_bframes(num_bframes), pyramid_mode(mode), keyint_max(keyint_max), keyint_min(keyint_min), frame_references(frame_references), fixed_keyframes(fixed_keyframes), keyframes(keyframes) {};  // validated by H264, fields can be changed after construction
   } gop;
 
+  struct LatencyParams {
+    bool low_latency; // no lookahead, no B-frames, sliced threads: every frame comes out of the encoder as soon as it goes in
+    bool intra_refresh; // periodic intra refresh across keyint_max frames instead of IDR frames (only the first frame is one), evens out frame sizes
+    // per-frame encode time budget in ms (0: none), frames over budget are counted as late and subpel refinement
+    // is lowered step by step until encoding catches up, then restored after kH264PacingRecoveryFrames
+    uint32_t frame_budget_ms;
+    LatencyParams(bool low_latency = false,
+                  bool intra_refresh = false,
+                  uint32_t frame_budget_ms = 0)
+      : low_latency(low_latency), intra_refresh(intra_refresh), frame_budget_ms(frame_budget_ms) {
+      THROW_IF(frame_budget_ms && !low_latency, InvalidArguments, "frame budget requires low latency");
+    };
+  } latency;
+
   // Other Params
   VideoProfileType profile;
   float fps;
@@ -172,18 +193,41 @@ struct H264Params {
              const RateControlParams& rc,
              const GopParams& gop,
              const VideoProfileType profile,
-             float fps = 30.0)
-    : computation(computation), rc(rc), gop(gop), profile(profile), fps(fps) {};
+             float fps = 30.0,
+             const LatencyParams& latency = LatencyParams())
+    : computation(computation), rc(rc), gop(gop), latency(latency), profile(profile), fps(fps) {};
 };
 
 class PUBLIC H264 final : public functional::DirectVideo<H264, Sample> {
   std::shared_ptr<struct _H264> _this;
 public:
+  struct Stats {
+    uint32_t frames = 0;  // frames handed to x264
+    uint32_t samples = 0;
+    uint32_t queue_depth = 0;  // frames held inside x264 after the last sample
+    uint32_t max_queue_depth = 0;
+    uint64_t encode_time_us = 0;  // time spent in x264 for the last sample
+    uint64_t max_encode_time_us = 0;
+    uint64_t total_encode_time_us = 0;
+    uint32_t sample_bits = 0;  // size of the last sample
+    uint64_t total_bits = 0;
+    uint32_t late_frames = 0;  // samples over frame_budget_ms, the frames a live source would have dropped
+    uint32_t subpel_refine = 0;  // current subpel refinement, lowered by pacing
+  };
+
   H264(const functional::Video<frame::Frame>& frames, float crf, uint32_t optimization, float fps, uint32_t max_bitrate = 0, uint32_t thread_count = 0);
   H264(const functional::Video<frame::Frame>& frames, const H264Params& params);
   H264(const H264& h264);
   DISALLOW_ASSIGN(H264);
   auto operator()(uint32_t sample) const -> Sample;
+  auto stats() const -> Stats;  // safe to call while another thread encodes
+
+  // Dual-pass ABR / CBR encode without a stats_log_path: the first pass encodes every frame with x264's fast first pass analysis
+  // (same GOP structure, x264 rejects statistics that do not match it) and its statistics are kept in memory; the returned
+  // encoder is the second pass. x264 only takes statistics files, they live in a private directory under stats_dir
+  // (default: /dev/shm, throws without it) while the first pass writes them and until the second pass encoder is destroyed.
+  // The first cache_frames decoded frames of the first pass are kept until the second pass pulls them, all other frames are fetched (decoded) again
+  static auto TwoPass(const functional::Video<frame::Frame>& frames, const H264Params& params, uint32_t cache_frames = 0, const string& stats_dir = "") -> H264;
 };
 
 }}
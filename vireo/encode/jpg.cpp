@@ -28,13 +28,12 @@
 
 #include "imagecore/image/yuv.h"
 #include "imagecore/imagecore.h"
-#include "imagecore/formats/writer.h"
-#undef LOCAL
 #include "vireo/base_cpp.h"
 #include "vireo/common/security.h"
 #include "vireo/common/enum.hpp"
 #include "vireo/encode/jpg.h"
 #include "vireo/error/error.h"
+#include "vireo/internal/encode/image.h"
 #include "vireo/util/util.h"
 #include "vireo/frame/util.h"
 
@@ -64,11 +63,7 @@ JPG::JPG(const functional::Video<frame::YUV>& frames, int quality, int optimizat
   _this->frames = frames;
 }
 
-auto JPG::operator()(uint32_t index) const -> common::Data32 {
-  THROW_IF(index >= count(), OutOfRange);
-  THROW_IF(index >= _this->frames.count(), OutOfRange);
-
-  frame::YUV frame = _this->frames(index);
+static auto encode(const frame::YUV& frame, int quality, int optimization, ImageWriter& writer) -> bool {
   THROW_IF(frame.uv_ratio().first != 2 || frame.uv_ratio().second != 2, Unsupported); // Only YUV420 supported
 
   auto fill_padding = [&frame]() {
@@ -105,20 +100,27 @@ auto JPG::operator()(uint32_t index) const -> common::Data32 {
     }
   };
 
-
-  ImageWriter::MemoryStorage storage(frame.plane(frame::Y).row() * frame.plane(frame::Y).height());
-  unique_ptr<ImageWriter> writer(ImageWriter::createWithFormat(kImageFormat_JPEG, &storage));
-  CHECK(writer);
   fill_padding();
   ImageWriter::EWriteOptions write_options = (ImageWriter::EWriteOptions)(ImageWriter::kWriteOption_CopyColorProfile |
                                                                           ImageWriter::kWriteOption_AssumeMCUPaddingFilled);
-  if (_this->optimization == 0) {
+  if (optimization == 0) {
     write_options = (ImageWriter::EWriteOptions)(write_options | ImageWriter::kWriteOption_QualityFast);
   }
-  writer->setWriteOptions(write_options);
-  writer->setQuality(_this->quality);
+  writer.setWriteOptions(write_options);
+  writer.setQuality(quality);
   auto src = unique_ptr<ImageYUV>(as_imagecore(frame));
-  writer->writeImage(src.get());
+  return writer.writeImage(src.get());
+}
+
+auto JPG::operator()(uint32_t index) const -> common::Data32 {
+  THROW_IF(index >= count(), OutOfRange);
+  THROW_IF(index >= _this->frames.count(), OutOfRange);
+
+  frame::YUV frame = _this->frames(index);
+  ImageWriter::MemoryStorage storage(frame.plane(frame::Y).row() * frame.plane(frame::Y).height());
+  unique_ptr<ImageWriter> writer(ImageWriter::createWithFormat(kImageFormat_JPEG, &storage));
+  CHECK(writer);
+  encode(frame, _this->quality, _this->optimization, *writer);
 
   uint8_t* buffer = NULL;
   uint64_t length = 0;
@@ -130,4 +132,11 @@ auto JPG::operator()(uint32_t index) const -> common::Data32 {
   return jpg_data;
 }
 
+auto JPG::operator()(uint32_t index, uint32_t count, uint32_t thread_count) const -> vector<common::Data32> {
+  THROW_IF(index + count > this->count(), OutOfRange);
+  return internal::encode::encode_batch(_this->frames, index, count, thread_count, kImageFormat_JPEG, [quality = _this->quality, optimization = _this->optimization](const frame::YUV& frame, ImageWriter& writer) {
+    return encode(frame, quality, optimization, writer);
+  });
+}
+
 }}
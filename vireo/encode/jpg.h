@@ -38,6 +38,9 @@ public:
   JPG(const functional::Video<frame::YUV>& frames, int quality, int optimization);
   DISALLOW_COPY_AND_ASSIGN(JPG);
   auto operator()(uint32_t sample) const -> common::Data32;
+  // Encodes count frames starting at index on thread_count threads (0: one per core), in index order. Frames are pulled
+  // one at a time, so whatever produces them (decoding, scaling, ...) is not parallelized, only the image encoding is
+  auto operator()(uint32_t index, uint32_t count, uint32_t thread_count = 0) const -> vector<common::Data32>;
 };
 
 }}
@@ -0,0 +1,165 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <map>
+#include <mutex>
+#include <numeric>
+
+#include "vireo/base_cpp.h"
+#include "vireo/common/security.h"
+#include "vireo/encode/ladder.h"
+#include "vireo/error/error.h"
+
+namespace vireo {
+namespace encode {
+
+// Frames shared by the encoders of all renditions
+struct _LadderSource {
+  functional::Video<frame::Frame> frames;
+  vector<pair<uint16_t, uint16_t>> dimensions;
+  uint32_t cache_size;
+  struct Entry {
+    vector<unique_ptr<frame::YUV>> yuvs;  // per rendition, released once pulled
+    uint32_t pending;
+  };
+  std::map<uint32_t, Entry> cache;
+  vector<int64_t> positions;  // last frame index pulled per rendition
+  std::mutex lock;
+
+  _LadderSource(const functional::Video<frame::Frame>& frames, const vector<pair<uint16_t, uint16_t>>& dimensions, uint32_t cache_size)
+    : frames(frames), dimensions(dimensions), cache_size(cache_size), positions(dimensions.size(), -1) {}
+
+  // Scales frame index for the given renditions, each from the smallest level of a 2x2 reduction pyramid that is still large enough
+  auto scale(uint32_t index, const vector<uint32_t>& renditions) -> Entry {
+    const frame::YUV source = frames(index).yuv();
+    THROW_IF(source.uv_ratio().first != 2 || source.uv_ratio().second != 2, Unsupported);
+    vector<frame::YUV> pyramid = { source };
+    Entry entry = { vector<unique_ptr<frame::YUV>>(dimensions.size()), (uint32_t)renditions.size() };
+    for (auto rendition: renditions) {
+      const uint16_t width = dimensions[rendition].first;
+      const uint16_t height = dimensions[rendition].second;
+      while (pyramid.back().width() / 2 >= width && pyramid.back().height() / 2 >= height &&
+             pyramid.back().width() % 4 == 0 && pyramid.back().height() % 4 == 0) {
+        pyramid.push_back(pyramid.back().reduce_half());
+      }
+      uint32_t level = (uint32_t)pyramid.size() - 1;
+      while (level && (pyramid[level].width() < width || pyramid[level].height() < height)) {
+        --level;
+      }
+      frame::YUV yuv = pyramid[level];
+      if (yuv.width() == width && yuv.height() == height) {
+        entry.yuvs[rendition].reset(new frame::YUV(yuv));
+      } else {
+        entry.yuvs[rendition].reset(new frame::YUV(yuv.stretch(width, yuv.width(), height, yuv.height())));
+      }
+    }
+    return entry;
+  }
+
+  // Whether rendition has not pulled index yet and will pull it before it is evicted from the cache
+  auto expects(uint32_t rendition, uint32_t index) const -> bool {
+    const int64_t next = positions[rendition] + 1;
+    return index >= next && index - next < cache_size;
+  }
+
+  auto yuv(uint32_t rendition, uint32_t index) -> frame::YUV {
+    std::lock_guard<std::mutex> guard(lock);
+    positions[rendition] = index;
+    auto it = cache.find(index);
+    if (it == cache.end()) {
+      // a miss only scales for renditions that are going to use the frame, a lagging or restarted rendition does not
+      // make every other rendition decode and scale again
+      vector<uint32_t> renditions = { rendition };
+      for (uint32_t r = 0; r < dimensions.size(); ++r) {
+        if (r != rendition && expects(r, index)) {
+          renditions.push_back(r);
+        }
+      }
+      Entry entry = scale(index, renditions);
+      if (renditions.size() == 1) {
+        return *entry.yuvs[rendition];
+      }
+      it = cache.emplace(index, move(entry)).first;
+      while (cache.size() > cache_size && cache.begin()->first != index) {
+        cache.erase(cache.begin());
+      }
+    }
+    if (!it->second.yuvs[rendition]) {  // pulled again, e.g. by an encoder that was restarted
+      return *scale(index, { rendition }).yuvs[rendition];
+    }
+    frame::YUV yuv = *it->second.yuvs[rendition];
+    it->second.yuvs[rendition].reset();
+    if (--it->second.pending == 0) {
+      cache.erase(it);
+    }
+    return yuv;
+  }
+};
+
+struct _Ladder {
+  vector<H264> encoders;
+};
+
+Ladder::Ladder(const functional::Video<frame::Frame>& frames, const vector<Rendition>& renditions, uint32_t keyframe_interval, uint32_t cache_size)
+  : _this(new _Ladder()) {
+  THROW_IF(renditions.empty(), InvalidArguments);
+  THROW_IF(!keyframe_interval, InvalidArguments);
+  THROW_IF(!cache_size, InvalidArguments);
+  vector<pair<uint16_t, uint16_t>> dimensions;
+  for (const auto& rendition: renditions) {
+    THROW_IF(!security::valid_dimensions(rendition.width, rendition.height), Unsafe);
+    dimensions.push_back(make_pair(rendition.width, rendition.height));
+  }
+  auto source = make_shared<_LadderSource>(frames, dimensions, cache_size);
+  for (uint32_t r = 0; r < renditions.size(); ++r) {
+    auto settings = frames.settings();
+    settings.width = renditions[r].width;
+    settings.height = renditions[r].height;
+    functional::Video<frame::Frame> scaled([source, r](uint32_t index) -> frame::Frame {
+      frame::Frame frame;
+      frame.pts = source->frames(index).pts;
+      frame.yuv = [source, r, index]() -> frame::YUV {
+        return source->yuv(r, index);
+      };
+      return frame;
+    }, frames.a(), frames.b(), settings);
+    H264Params params = renditions[r].params;
+    params.gop.keyint_max = keyframe_interval;
+    params.gop.fixed_keyframes = true;
+    _this->encoders.push_back(H264(scaled, params));
+  }
+}
+
+Ladder::Ladder(const Ladder& ladder) : _this(ladder._this) {}
+
+auto Ladder::count() const -> uint32_t {
+  return (uint32_t)_this->encoders.size();
+}
+
+auto Ladder::operator()(uint32_t rendition) const -> H264 {
+  THROW_IF(rendition >= count(), OutOfRange);
+  return _this->encoders[rendition];
+}
+
+}}
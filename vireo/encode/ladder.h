@@ -0,0 +1,59 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "vireo/base_h.h"
+#include "vireo/constants.h"
+#include "vireo/encode/h264.h"
+#include "vireo/frame/frame.h"
+#include "vireo/functional/media.hpp"
+
+namespace vireo {
+namespace encode {
+
+// Encodes one stream of frames into several renditions (ABR ladder), each scaled to its own dimensions and encoded
+// by its own encode::H264 with its own parameters.
+// - every source frame is fetched (decoded) once and scaled for all renditions at the same time, through a shared
+//   pyramid of 2x2 reductions, as long as renditions are consumed roughly in lockstep (e.g. sample i of every
+//   rendition before sample i + 1); a frame is only scaled for the renditions that will pull it within the next
+//   cache_size frames, a rendition lagging further behind fetches and scales frames again for itself only
+// - keyframes are forced every keyframe_interval frames and scene cut detection is disabled, so all renditions have
+//   IDR frames at the same positions and can be switched between at segment boundaries
+class PUBLIC Ladder final {
+  std::shared_ptr<struct _Ladder> _this = nullptr;
+public:
+  struct Rendition {
+    uint16_t width;
+    uint16_t height;
+    H264Params params;
+  };
+  Ladder(const functional::Video<frame::Frame>& frames, const vector<Rendition>& renditions, uint32_t keyframe_interval, uint32_t cache_size = kLadderCacheSize);
+  Ladder(const Ladder& ladder);
+  DISALLOW_ASSIGN(Ladder);
+  auto count() const -> uint32_t;  // number of renditions
+  auto operator()(uint32_t rendition) const -> H264;
+};
+
+}}
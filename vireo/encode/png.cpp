@@ -28,13 +28,12 @@
 
 #include "imagecore/image/rgba.h"
 #include "imagecore/imagecore.h"
-#include "imagecore/formats/writer.h"
-#undef LOCAL
 #include "vireo/base_cpp.h"
 #include "vireo/common/security.h"
 #include "vireo/common/enum.hpp"
 #include "vireo/encode/png.h"
 #include "vireo/error/error.h"
+#include "vireo/internal/encode/image.h"
 #include "vireo/util/util.h"
 #include "vireo/frame/util.h"
 
@@ -59,6 +58,11 @@ PNG::PNG(const functional::Video<frame::RGB>& frames)
   _this->frames = frames;
 }
 
+static auto encode(const frame::RGB& frame, ImageWriter& writer) -> bool {
+  auto src = unique_ptr<ImageRGBA>(as_imagecore(frame));
+  return writer.writeImage(src.get());
+}
+
 auto PNG::operator()(uint32_t index) const -> common::Data32 {
   THROW_IF(index >= count(), OutOfRange);
   THROW_IF(index >= _this->frames.count(), OutOfRange);
@@ -68,8 +72,7 @@ auto PNG::operator()(uint32_t index) const -> common::Data32 {
   ImageWriter::MemoryStorage storage(frame.plane().bytes().count());
   unique_ptr<ImageWriter> writer(ImageWriter::createWithFormat(kImageFormat_PNG, &storage));
   CHECK(writer);
-  auto src = unique_ptr<ImageRGBA>(as_imagecore(frame));
-  writer->writeImage(src.get());
+  encode(frame, *writer);
 
   uint8_t* buffer = NULL;
   uint64_t length = 0;
@@ -81,4 +84,11 @@ auto PNG::operator()(uint32_t index) const -> common::Data32 {
   return png_data;
 }
 
+auto PNG::operator()(uint32_t index, uint32_t count, uint32_t thread_count) const -> vector<common::Data32> {
+  THROW_IF(index + count > this->count(), OutOfRange);
+  return internal::encode::encode_batch(_this->frames, index, count, thread_count, kImageFormat_PNG, [](const frame::RGB& frame, ImageWriter& writer) {
+    return encode(frame, writer);
+  });
+}
+
 }}
@@ -0,0 +1,142 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <deque>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "imagecore/imagecore.h"
+#include "vireo/base_cpp.h"
+#include "vireo/error/error.h"
+#include "vireo/frame/pool.h"
+
+namespace vireo {
+namespace frame {
+
+static const uint32_t kPoolSizeClassShift = 12;  // size classes are multiples of a page
+
+struct _Pool {
+  struct Buffer {
+    uint32_t size_class;
+    uint8_t* buffer;
+  };
+  std::mutex lock;
+  const uint64_t max_size;
+  uint64_t size = 0;
+  std::list<Buffer> free_buffers;  // most recently released first
+  unordered_map<uint32_t, std::deque<std::list<Buffer>::iterator>> buffers;  // size class -> free buffers, most recently released last
+  _Pool(uint64_t max_size) : max_size(max_size) {}
+  ~_Pool() {
+    clear();
+  }
+  static auto SizeClass(uint32_t size) -> uint32_t {
+    const uint32_t mask = (1 << kPoolSizeClassShift) - 1;
+    THROW_IF(size > numeric_limits<uint32_t>::max() - mask, Overflow);
+    return (size + mask) & ~mask;
+  }
+  auto acquire(uint32_t size_class) -> uint8_t* {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      auto it = buffers.find(size_class);
+      if (it != buffers.end() && !it->second.empty()) {
+        uint8_t* buffer = it->second.back()->buffer;
+        free_buffers.erase(it->second.back());
+        it->second.pop_back();
+        size -= size_class;
+        return buffer;
+      }
+    }
+    uint8_t* buffer = (uint8_t*)memalign(IMAGE_ROW_DEFAULT_ALIGNMENT, size_class);
+    THROW_IF(!buffer, OutOfMemory);
+    return buffer;
+  }
+  // Over budget, the least recently released buffers make room whatever their size class, so that buffers of sizes
+  // no longer in use (e.g. after a resolution change) do not keep the sizes in use from being pooled
+  auto release(uint8_t* buffer, uint32_t size_class) -> void {
+    vector<uint8_t*> evicted;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (size_class <= max_size) {
+        while (size + size_class > max_size) {
+          const Buffer& oldest = free_buffers.back();
+          auto& size_class_buffers = buffers[oldest.size_class];
+          CHECK(size_class_buffers.front() == std::prev(free_buffers.end()));
+          size_class_buffers.pop_front();
+          if (size_class_buffers.empty()) {
+            buffers.erase(oldest.size_class);
+          }
+          size -= oldest.size_class;
+          evicted.push_back(oldest.buffer);
+          free_buffers.pop_back();
+        }
+        free_buffers.push_front({ size_class, buffer });
+        buffers[size_class].push_back(free_buffers.begin());
+        size += size_class;
+        buffer = nullptr;
+      }
+    }
+    for (auto evicted_buffer: evicted) {
+      free(evicted_buffer);
+    }
+    free(buffer);
+  }
+  auto clear() -> void {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto& free_buffer: free_buffers) {
+      free(free_buffer.buffer);
+    }
+    free_buffers.clear();
+    buffers.clear();
+    size = 0;
+  }
+};
+
+Pool::Pool(uint64_t max_size) : _this(make_shared<_Pool>(max_size)) {}
+
+Pool::Pool(const Pool& pool) : _this(pool._this) {}
+
+auto Pool::Shared() -> Pool& {
+  static Pool pool;
+  return pool;
+}
+
+auto Pool::allocate(uint32_t size) -> common::Data32 {
+  const uint32_t size_class = _Pool::SizeClass(size);
+  uint8_t* buffer = _this->acquire(size_class);
+  return common::Data32(buffer, size, [_this = _this, size_class](uint8_t* p) {
+    _this->release(p, size_class);
+  });
+}
+
+auto Pool::size() const -> uint64_t {
+  std::lock_guard<std::mutex> guard(_this->lock);
+  return _this->size;
+}
+
+auto Pool::clear() -> void {
+  _this->clear();
+}
+
+}}
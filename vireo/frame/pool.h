@@ -0,0 +1,50 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "vireo/base_h.h"
+#include "vireo/common/data.h"
+#include "vireo/constants.h"
+
+namespace vireo {
+namespace frame {
+
+// Thread-safe recycler for plane buffers: once the last copy of a buffer handed out by allocate() is released, the buffer
+// goes back to the pool instead of being freed, and is reused for the next buffer of the same size class. Past max_size bytes
+// the least recently released buffers are freed first, whatever their size class.
+// Buffers are IMAGE_ROW_DEFAULT_ALIGNMENT aligned and their content is undefined.
+class PUBLIC Pool final {
+  std::shared_ptr<struct _Pool> _this = nullptr;
+public:
+  Pool(uint64_t max_size = kFramePoolSize);
+  Pool(const Pool& pool);
+  DISALLOW_ASSIGN(Pool);
+  static auto Shared() -> Pool&;  // used by frame::YUV and frame::RGB
+  auto allocate(uint32_t size) -> common::Data32;
+  auto size() const -> uint64_t;  // bytes held for reuse
+  auto clear() -> void;
+};
+
+}}
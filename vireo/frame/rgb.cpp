@@ -30,6 +30,7 @@
 #include "vireo/common/security.h"
 #include "vireo/constants.h"
 #include "vireo/error/error.h"
+#include "vireo/frame/pool.h"
 #include "vireo/frame/rgb.h"
 #include "vireo/frame/util.h"
 #include "vireo/frame/yuv.h"
@@ -63,7 +64,7 @@ RGB::RGB(uint16_t width, uint16_t height, uint8_t component_count) {
   THROW_IF(!security::valid_dimensions(width, height), Unsafe);
   const uint16_t row = common::align_shift(width * component_count, IMAGE_ROW_DEFAULT_ALIGNMENT_SHIFT);
   const uint32_t size = row * height + IMAGE_ROW_DEFAULT_ALIGNMENT; // sws_scale uses vector registers that access extra bytes after the meaningful data
-  common::Data32 rgb_data((uint8_t*)memalign(IMAGE_ROW_DEFAULT_ALIGNMENT, size), size, [](uint8_t* p) { free(p); });
+  common::Data32 rgb_data = Pool::Shared().allocate(size);
   memset((void*)rgb_data.data(), 0, size);
   frame::Plane plane(row, width * component_count, height, move(rgb_data));
   _this = new _RGB(component_count, move(plane));
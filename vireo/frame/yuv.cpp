@@ -28,9 +28,9 @@
 #include "vireo/common/ref.h"
 #include "vireo/common/math.h"
 #include "vireo/common/security.h"
-#include "vireo/common/enum.hpp"
 #include "vireo/constants.h"
 #include "vireo/error/error.h"
+#include "vireo/frame/pool.h"
 #include "vireo/frame/rgb.h"
 #include "vireo/frame/util.h"
 #include "vireo/frame/yuv.h"
@@ -67,9 +67,9 @@ YUV::YUV(uint16_t width, uint16_t height, uint8_t uv_x_ratio, uint8_t uv_y_ratio
   const uint16_t uv_row = common::align_shift(row / uv_x_ratio, IMAGE_ROW_DEFAULT_ALIGNMENT_SHIFT);
   const uint16_t uv_column = common::align_shift(column / uv_y_ratio, IMAGE_ROW_DEFAULT_ALIGNMENT_SHIFT);
   const uint32_t uv_size = uv_row * uv_column + IMAGE_ROW_DEFAULT_ALIGNMENT; // sws_scale uses vector registers that access extra bytes after the meaningful data
-  common::Data32 y_data((uint8_t*)memalign(IMAGE_ROW_DEFAULT_ALIGNMENT, size), size,       [](uint8_t* p) { free(p); });
-  common::Data32 u_data((uint8_t*)memalign(IMAGE_ROW_DEFAULT_ALIGNMENT, uv_size), uv_size, [](uint8_t* p) { free(p); });
-  common::Data32 v_data((uint8_t*)memalign(IMAGE_ROW_DEFAULT_ALIGNMENT, uv_size), uv_size, [](uint8_t* p) { free(p); });
+  common::Data32 y_data = Pool::Shared().allocate(size);
+  common::Data32 u_data = Pool::Shared().allocate(uv_size);
+  common::Data32 v_data = Pool::Shared().allocate(uv_size);
   memset((void*)y_data.data(), 0, size);
   memset((void*)u_data.data(), 128, uv_size);
   memset((void*)v_data.data(), 128, uv_size);
@@ -122,87 +122,9 @@ auto YUV::rgb<std::false_type>(uint8_t component_count) -> RGB {
 auto YUV::full_range(bool full_range) -> YUV {
   THROW_IF(_this->full_range == full_range, InvalidArguments);
   frame::YUV new_yuv(width(), height(), uv_ratio().first, uv_ratio().second, full_range);
-  uint8_t* const src[] = {
-    (uint8_t* const)plane(frame::Y).bytes().data(),
-    (uint8_t* const)plane(frame::U).bytes().data(),
-    (uint8_t* const)plane(frame::V).bytes().data()
-  };
-  uint8_t* const dst[] = {
-    (uint8_t* const)new_yuv.plane(frame::Y).bytes().data(),
-    (uint8_t* const)new_yuv.plane(frame::U).bytes().data(),
-    (uint8_t* const)new_yuv.plane(frame::V).bytes().data()
-  };
-  const int src_stride[] = {
-    plane(frame::Y).row(),
-    plane(frame::U).row(),
-    plane(frame::V).row()
-  };
-  const int dst_stride[] = {
-    new_yuv.plane(frame::Y).row(),
-    new_yuv.plane(frame::U).row(),
-    new_yuv.plane(frame::V).row()
-  };
-  const int width[] = {
-    plane(frame::Y).width(),
-    plane(frame::U).width(),
-    plane(frame::V).width()
-  };
-  const int height[] = {
-    plane(frame::Y).height(),
-    plane(frame::U).height(),
-    plane(frame::V).height()
-  };
-
-#define CLIP3(x, low, high) ({\
-  __typeof__(x) _x = x;\
-  (((_x) < (low)) ? (low) : ((_x) > (high)) ? (high) : (_x));\
-})
-
-  const int16_t   _0 =   0;
-  const int16_t  _16 =  16;
-  const int16_t _219 = 219;
-  const int16_t _224 = 224;
-  const int16_t _128 = 128;
-  const int16_t _235 = 235;
-  const int16_t _240 = 240;
-  const int16_t _255 = 255;
-  if (full_range) {
-    int p = frame::Y;
-    for (int y = 0; y < height[p]; ++y) {
-      uint8_t* sptr = src[p] + y * src_stride[p];
-      uint8_t* dptr = dst[p] + y * dst_stride[p];
-      for (int x = 0, w = width[p]; x < w; ++x) {
-        *dptr++ = (uint8_t)CLIP3((int16_t)_255 * ((int16_t)*sptr++ - _16) / _219, _0, _255);
-      }
-    }
-    for (auto p: enumeration::Enum<frame::PlaneIndex>(frame::U, frame::V)) {
-      for (int y = 0; y < height[p]; ++y) {
-        uint8_t* sptr = src[p] + y * src_stride[p];
-        uint8_t* dptr = dst[p] + y * dst_stride[p];
-        for (int x = 0, w = width[p]; x < w; ++x) {
-          *dptr++ = (uint8_t)CLIP3((int16_t)_255 * ((int16_t)*sptr++ - _128) / _224 + _128, _0, _255);
-        }
-      }
-    }
-  } else {
-    int p = frame::Y;
-    for (int y = 0; y < height[p]; ++y) {
-      uint8_t* sptr = src[p] + y * src_stride[p];
-      uint8_t* dptr = dst[p] + y * dst_stride[p];
-      for (int x = 0, w = width[p]; x < w; ++x) {
-        *dptr++ = (uint8_t)CLIP3((int16_t)_219 * *sptr++ / _255 + _16, _16, _235);
-      }
-    }
-    for (auto p: enumeration::Enum<frame::PlaneIndex>(frame::U, frame::V)) {
-      for (int y = 0; y < height[p]; ++y) {
-        uint8_t* sptr = src[p] + y * src_stride[p];
-        uint8_t* dptr = dst[p] + y * dst_stride[p];
-        for (int x = 0, w = width[p]; x < w; ++x) {
-          *dptr++ = (uint8_t)CLIP3((int16_t)_224 * ((int16_t)*sptr++ - _128) / _255 + _128, _16, _240);
-        }
-      }
-    }
-  }
+  unique_ptr<ImageYUV> src(as_imagecore(*this));
+  unique_ptr<ImageYUV> dst(as_imagecore(new_yuv));
+  src->convertRange(dst.get(), full_range ? kYUVRange_Full : kYUVRange_Compressed);
   return new_yuv;
 }
 
@@ -223,6 +145,15 @@ auto YUV::crop(uint16_t x_offset, uint16_t y_offset, uint16_t cropped_width, uin
   return new_yuv;
 }
 
+static auto as_orientation(Rotation direction) -> EImageOrientation {
+  switch (direction) {
+    case Rotation::Right: return EImageOrientation::kImageOrientation_Right;
+    case Rotation::Down: return EImageOrientation::kImageOrientation_Down;
+    case Rotation::Left: return EImageOrientation::kImageOrientation_Left;
+    default: return EImageOrientation::kImageOrientation_Up;
+  }
+}
+
 auto YUV::rotate(Rotation direction) -> YUV {
   THROW_IF(uv_ratio().first != 2 || uv_ratio().second != 2, Unsupported);
   THROW_IF(direction == Rotation::None, InvalidArguments);
@@ -274,4 +205,55 @@ auto YUV::stretch(int num_x, int denum_x, int num_y, int denum_y, bool high_qual
   return new_yuv;
 }
 
+auto YUV::reduce_half() const -> YUV {
+  THROW_IF(uv_ratio().first != 2 || uv_ratio().second != 2, Unsupported);
+  THROW_IF(width() % 4 || height() % 4, InvalidArguments);
+
+  unique_ptr<ImageYUV> src_yuv(as_imagecore(*this));
+  frame::YUV new_yuv(width() / 2, height() / 2, uv_ratio().first, uv_ratio().second, full_range());
+  unique_ptr<ImageYUV> dst_yuv(as_imagecore(new_yuv));
+  src_yuv->reduceHalf(dst_yuv.get());
+
+  return new_yuv;
+}
+
+auto YUV::transform(uint16_t x_offset, uint16_t y_offset, uint16_t cropped_width, uint16_t cropped_height,
+                    uint16_t out_width, uint16_t out_height, Rotation direction, bool high_quality) const -> YUV {
+  THROW_IF(uv_ratio().first != 2 || uv_ratio().second != 2, Unsupported);
+  THROW_IF(!(cropped_width > 0 && cropped_height > 0 && cropped_width <= 8192 && cropped_height <= 8192), InvalidArguments);
+  THROW_IF(x_offset + cropped_width > width() || y_offset + cropped_height > height(), InvalidArguments);
+  THROW_IF(!security::valid_dimensions(out_width, out_height), Unsafe);
+  const bool flip_coords = direction == Rotation::Left || direction == Rotation::Right;
+  const uint16_t scaled_width  = flip_coords ? out_height : out_width;
+  const uint16_t scaled_height = flip_coords ? out_width : out_height;
+  const bool needs_scale = scaled_width != cropped_width || scaled_height != cropped_height;
+  const bool needs_rotate = direction != Rotation::None;
+  const bool is_up_sample = scaled_width > cropped_width || scaled_height > cropped_height;
+  const EResizeQuality resize_quality = high_quality ? kResizeQuality_High : (is_up_sample ? kResizeQuality_Low : kResizeQuality_Bilinear);
+
+  // cropping only offsets the source planes, pixels are read once by the first pass below
+  unique_ptr<ImageYUV> src_yuv(as_imagecore(*this));
+  if (x_offset || y_offset || cropped_width != width() || cropped_height != height()) {
+    src_yuv->crop(ImageRegion(cropped_width, cropped_height, x_offset, y_offset));
+  }
+
+  frame::YUV new_yuv(out_width, out_height, uv_ratio().first, uv_ratio().second, full_range());
+  unique_ptr<ImageYUV> dst_yuv(as_imagecore(new_yuv));
+  if (needs_scale && needs_rotate && is_up_sample) {
+    // rotate at the lower, source resolution
+    frame::YUV rotated_yuv(flip_coords ? cropped_height : cropped_width, flip_coords ? cropped_width : cropped_height, uv_ratio().first, uv_ratio().second, full_range());
+    unique_ptr<ImageYUV> rotated(as_imagecore(rotated_yuv));
+    src_yuv->rotate(rotated.get(), as_orientation(direction));
+    CHECK(rotated->resize(dst_yuv.get(), resize_quality));
+  } else if (needs_scale) {
+    // Left / Right are written by the last filter pass, without a scaled intermediate frame
+    CHECK(src_yuv->resize(dst_yuv.get(), resize_quality, as_orientation(direction)));
+  } else if (needs_rotate) {
+    src_yuv->rotate(dst_yuv.get(), as_orientation(direction));
+  } else {
+    src_yuv->copy(dst_yuv.get());
+  }
+  return new_yuv;
+}
+
 }}
@@ -60,6 +60,12 @@ public:
   auto rotate(Rotation direction) -> YUV;
   auto scale(int num, int denum) -> YUV { return stretch(num, denum, num, denum); }
   auto stretch(int num_x, int denum_x, int num_y, int denum_y, bool high_quality = true) -> YUV;
+  // 2x2 box filter downscale, a lot cheaper than scale(1, 2); width and height have to be multiples of 4
+  auto reduce_half() const -> YUV;
+  // crop, then scale to out_width x out_height (final dimensions, i.e. after rotation), then rotate; cropping does not copy,
+  // a downscale rotates Left / Right within its last filter pass, upscaling rotates at the source resolution first
+  auto transform(uint16_t x_offset, uint16_t y_offset, uint16_t cropped_width, uint16_t cropped_height,
+                 uint16_t out_width, uint16_t out_height, Rotation direction, bool high_quality = true) const -> YUV;
 };
 
 }}
@@ -51,8 +51,10 @@ struct _AAC {
       aacDecoder_Close(p);
     }
   }};
-  // This scratch buffer is used to stage the data before it gets passed to the decoder.
-  // It is needed because fdk-aac internal code sometimes reads up to 4 extra bytes past the end of the bitstream.
+  // fdk-aac internal code sometimes reads up to 4 extra bytes past the end of the bitstream.
+  constexpr static const uint32_t kPaddingSize = 4;
+  // This scratch buffer is used to stage the data before it gets passed to the decoder,
+  // when the sample data does not already have enough readable bytes past its end.
   common::Data32 scratch_buffer = { (uint8_t*)calloc(kMaxBufferSize, sizeof(uint8_t)), kMaxBufferSize, [](uint8_t* p) { free(p); } };
   common::Sample16 decoded_sample = { (int16_t*)calloc(kMaxBufferSize, sizeof(uint16_t)), kMaxBufferSize, [](int16_t* p) { free(p); } };
   settings::Audio audio_settings;
@@ -122,13 +124,17 @@ auto AAC::operator()(uint32_t index) const -> sound::Sound {
 
       const auto sample_data = sample.nal();
 
-      THROW_IF(sample_data.count() + 4 > _AAC::kMaxBufferSize, Unsafe);
-      _this->scratch_buffer.copy(sample_data);
+      THROW_IF(sample_data.count() + _AAC::kPaddingSize > _AAC::kMaxBufferSize, Unsafe);
+      const uint8_t* bytes = sample_data.data() + sample_data.a();
+      if (sample_data.capacity() - sample_data.b() < _AAC::kPaddingSize) {
+        _this->scratch_buffer.copy(sample_data);
+        bytes = _this->scratch_buffer.data();
+      }
 
-      const UINT size = _this->scratch_buffer.count();
+      const UINT size = sample_data.count();
       UINT valid_bytes_left = size;
       CHECK(aacDecoder_Fill(_this->decoder.get(),
-                            (UCHAR**)util::get_addr(_this->scratch_buffer.data()),
+                            (UCHAR**)&bytes,
                             &size,
                             &valid_bytes_left) == AAC_DEC_OK);
       CHECK(valid_bytes_left == 0);
@@ -23,6 +23,7 @@
  */
 
 #include <algorithm>
+#include <list>
 extern "C" {
 #include "libavformat/avformat.h"
 }
@@ -47,6 +48,66 @@ struct FrameInfo {
   bool keyframe;
 };
 
+static inline bool intra_decode_refresh(const common::Data32& data, const uint8_t nalu_length_size) {
+  uint8_t* bytes = (uint8_t*)data.data() + data.a();
+  uint32_t size = data.count();
+  while (size) {
+    THROW_IF(size <= nalu_length_size, Invalid);
+    if ((bytes[nalu_length_size] & 0x1F) == H264NalType::IDR) {
+      return true;
+    }
+    uint32_t nal_size = 0;
+    for (uint8_t i = 0; i < nalu_length_size; ++i) {
+      nal_size = nal_size << (CHAR_BIT * sizeof(uint8_t));
+      nal_size += bytes[i];
+    }
+    THROW_IF(size < (nalu_length_size + nal_size), Invalid);
+    size -= (nalu_length_size + nal_size);
+    bytes += (nalu_length_size + nal_size);
+  }
+  return false;
+}
+
+// LRU cache of decoded frames keyed by frame index, bounded by the memory held by the frame buffers
+class FrameCache {
+  typedef pair<uint32_t, shared_ptr<AVFrame>> Entry;
+  const uint32_t max_size;
+  uint64_t size = 0;
+  std::list<Entry> entries;  // most recently used first
+  unordered_map<uint32_t, std::list<Entry>::iterator> lookup;
+  static auto frame_size(const AVFrame* frame) -> uint64_t {
+    return (uint64_t)frame->linesize[0] * frame->height + (uint64_t)(frame->linesize[1] + frame->linesize[2]) * (frame->height / 2);
+  }
+public:
+  FrameCache(uint32_t max_size) : max_size(max_size) {}
+  auto get(uint32_t index) -> shared_ptr<AVFrame> {
+    auto it = lookup.find(index);
+    if (it == lookup.end()) {
+      return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+  }
+  auto put(uint32_t index, const AVFrame* frame) -> void {
+    const uint64_t new_size = frame_size(frame);
+    if (new_size > max_size || lookup.find(index) != lookup.end()) {
+      return;
+    }
+    while (size + new_size > max_size) {
+      size -= frame_size(entries.back().second.get());
+      lookup.erase(entries.back().first);
+      entries.pop_back();
+    }
+    shared_ptr<AVFrame> cached_frame(av_frame_clone(frame), [](AVFrame* frame) {
+      av_frame_free(&frame);
+    });
+    CHECK(cached_frame);
+    entries.emplace_front(index, cached_frame);
+    lookup[index] = entries.begin();
+    size += new_size;
+  }
+};
+
 struct _H264 {
   common::Data16 headers;
   AVCodec* codec = NULL;
@@ -56,10 +117,13 @@ struct _H264 {
   }};
   functional::Video<Sample> video_track;
   vector<FrameInfo> frame_infos;  // pts sorted list of frame information
+  vector<uint32_t> keyframe_indices;  // sorted list of samples flagged as keyframes
+  unordered_map<uint32_t, bool> idr_keyframes;  // keyframes parsed so far, true if they are actual IDR frames
+  FrameCache frame_cache;
   uint32_t num_cached_frames = 0;
   int64_t last_decoded_index = -1;
-  _H264(const functional::Video<Sample>& video_track, common::Data16&& headers, uint32_t thread_count)
-    : video_track(video_track), headers(move(headers)) {
+  _H264(const functional::Video<Sample>& video_track, common::Data16&& headers, uint32_t thread_count, uint32_t cache_size, bool fast)
+    : video_track(video_track), headers(move(headers)), frame_cache(cache_size) {
     codec = avcodec_find_decoder(AV_CODEC_ID_H264);
     CHECK(codec);
     codec_context.reset(avcodec_alloc_context3(codec));
@@ -72,24 +136,54 @@ struct _H264 {
       codec_context->thread_count = thread_count;
       codec_context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
     }
+    if (fast) {
+      // deblocking is a large share of the decode time and its absence is hardly visible once the frame is downscaled
+      codec_context->skip_loop_filter = AVDISCARD_ALL;
+      codec_context->flags2 |= AV_CODEC_FLAG2_FAST;
+    }
     CHECK(avcodec_open2(codec_context.get(), codec, NULL) >= 0);
   }
   auto process_samples() -> void {
     frame_infos.clear();
+    keyframe_indices.clear();
+    uint32_t index = 0;
     for (auto sample: video_track) {
       THROW_IF(video_track.count() >= security::kMaxSampleCount, Unsafe);
       THROW_IF(sample.type != SampleType::Video, InvalidArguments);
 
       FrameInfo frame_info = { sample.pts, sample.keyframe };
       frame_infos.push_back(frame_info);
+      if (sample.keyframe) {
+        keyframe_indices.push_back(index);
+      }
+      ++index;
     }
     sort(frame_infos.begin(), frame_infos.end(), [](const FrameInfo& a, const FrameInfo& b){
       return a.pts < b.pts;
     });
   }
+  // keyframes are only read and parsed once a random access needs them, and then remembered
+  auto previous_idr_frame(uint32_t index) -> uint32_t {
+    THROW_IF(index >= video_track.count(), OutOfRange);
+    const uint8_t nalu_length_size = video_track.settings().sps_pps.nalu_length_size;
+    auto it = upper_bound(keyframe_indices.begin(), keyframe_indices.end(), index);
+    while (it != keyframe_indices.begin()) {
+      const uint32_t keyframe_index = *--it;
+      auto idr = idr_keyframes.find(keyframe_index);
+      if (idr == idr_keyframes.end()) {
+        idr = idr_keyframes.emplace(keyframe_index, intra_decode_refresh(video_track(keyframe_index).nal(), nalu_length_size)).first;
+      }
+      if (idr->second) {
+        return keyframe_index;
+      }
+    }
+    // we return 0 if we cannot find an actual IDR frame <= index
+    // this ensures that we at least attempt to decode starting from first available frame
+    return 0;
+  }
 };
 
-H264::H264(const functional::Video<Sample>& track, uint32_t thread_count) {
+H264::H264(const functional::Video<Sample>& track, uint32_t thread_count, uint32_t cache_size, bool fast) {
   const auto& settings = track.settings();
   THROW_IF(settings.codec != settings::Video::Codec::H264, Unsupported);
   THROW_IF(!settings.timescale, Invalid);
@@ -104,7 +198,7 @@ H264::H264(const functional::Video<Sample>& track, uint32_t thread_count) {
   common::Data16 extradata_padded = { (const uint8_t*)calloc(padded_size, sizeof(uint8_t)), padded_size, [](uint8_t* p) { free(p); } };
   extradata_padded.copy(extradata);
 
-  _this = make_shared<_H264>(track, move(extradata_padded), thread_count);
+  _this = make_shared<_H264>(track, move(extradata_padded), thread_count, cache_size, fast);
   _this->process_samples();
   set_bounds(0, track.count());
 
@@ -115,26 +209,6 @@ H264::H264(const functional::Video<Sample>& track, uint32_t thread_count) {
 H264::H264(const H264& h264)
   : functional::DirectVideo<H264, frame::Frame>(h264.a(), h264.b(), h264.settings()), _this(h264._this) {}
 
-static inline bool intra_decode_refresh(const common::Data32& data, const uint8_t nalu_length_size) {
-  uint8_t* bytes = (uint8_t*)data.data() + data.a();
-  uint32_t size = data.count();
-  while (size) {
-    THROW_IF(size <= nalu_length_size, Invalid);
-    if ((bytes[nalu_length_size] & 0x1F) == H264NalType::IDR) {
-      return true;
-    }
-    uint32_t nal_size = 0;
-    for (uint8_t i = 0; i < nalu_length_size; ++i) {
-      nal_size = nal_size << (CHAR_BIT * sizeof(uint8_t));
-      nal_size += bytes[i];
-    }
-    THROW_IF(size < (nalu_length_size + nal_size), Invalid);
-    size -= (nalu_length_size + nal_size);
-    bytes += (nalu_length_size + nal_size);
-  }
-  return false;
-}
-
 auto H264::operator()(uint32_t index) const -> frame::Frame {
   THROW_IF(index >= count(), OutOfRange);
   THROW_IF(index >= _this->frame_infos.size(), OutOfRange);
@@ -148,21 +222,6 @@ auto H264::operator()(uint32_t index) const -> frame::Frame {
     });
     auto settings = _this->video_track.settings();
 
-    auto previous_idr_frame = [&_this, &settings](uint32_t index) -> uint32_t {
-      THROW_IF(index >= _this->video_track.count(), OutOfRange);
-      while (index) {
-        // we return 0 if we cannot find an actual IDR frame <= index
-        // this ensures that we at least attempt to decode starting from first available frame
-        const Sample& sample = _this->video_track((uint32_t)index);
-        bool is_idr = sample.keyframe && intra_decode_refresh(sample.nal(), settings.sps_pps.nalu_length_size);
-        if (is_idr) {
-          break;
-        }
-        index--;
-      }
-      return index;
-    };
-
     auto flush_decoder_buffers = [&_this]() {
       avcodec_flush_buffers(_this->codec_context.get());
       _this->num_cached_frames = 0;
@@ -180,7 +239,7 @@ auto H264::operator()(uint32_t index) const -> frame::Frame {
       }
     };
 
-    auto decode_frame = [_this = _this, &frame, keyframe, &settings, update_resolution](uint32_t index) {
+    auto decode_frame = [_this = _this, &frame, keyframe, &settings](uint32_t index) {
       THROW_IF(index >= _this->video_track.count(), OutOfRange);
       AVPacket packet;
       int got_picture = 0;
@@ -188,8 +247,9 @@ auto H264::operator()(uint32_t index) const -> frame::Frame {
         av_init_packet(&packet);
         if (index + _this->num_cached_frames < _this->video_track.count()) {
           const Sample& sample = _this->video_track(index + _this->num_cached_frames);
+          // libavcodec needs zeroed padding past its input: the bytes past a sample in the reader are the next sample, so this copy stays
           const common::Data32 nal = sample.nal();
-          av_new_packet(&packet, nal.count());
+          CHECK(av_new_packet(&packet, nal.count()) == 0);
           memcpy((void*)packet.data, nal.data() + nal.a(), nal.count());
           packet.pts = sample.pts;
           packet.dts = sample.dts;
@@ -208,9 +268,6 @@ auto H264::operator()(uint32_t index) const -> frame::Frame {
         }
         av_packet_unref(&packet);
         if (got_picture) {
-          if (settings.width == 0 && settings.height == 0) { // infer from decoded frame when not specified in settings
-            update_resolution(frame.get(), settings);
-          }
           THROW_IF(frame->format != AV_PIX_FMT_YUV420P && frame->format != AV_PIX_FMT_YUVJ420P, Unsupported);
         } else {
           _this->num_cached_frames++;
@@ -222,9 +279,14 @@ auto H264::operator()(uint32_t index) const -> frame::Frame {
       }
       CHECK(got_picture);
       _this->last_decoded_index = index;
+      _this->frame_cache.put(index, frame.get());
     };
 
-    if (index - _this->last_decoded_index == 1) {
+    auto cached_frame = _this->frame_cache.get(index);
+    if (cached_frame) {
+      // optimization: frame was decoded recently - no need to touch the decoder
+      CHECK(av_frame_ref(frame.get(), cached_frame.get()) == 0);
+    } else if (index - _this->last_decoded_index == 1) {
       // optimization: current sample is right after last decoded sample - continue normally
       decode_frame(index);
     } else {
@@ -235,7 +297,7 @@ auto H264::operator()(uint32_t index) const -> frame::Frame {
         }
         decode_frame(index);
       } else {
-        uint32_t index_to_start_decoding = previous_idr_frame(index);;
+        uint32_t index_to_start_decoding = _this->previous_idr_frame(index);
         if (index_to_start_decoding <= _this->last_decoded_index && index > _this->last_decoded_index) {
           // optimization: we can just decode the frames starting from last decoded index - no need to decode from previous IDR
           index_to_start_decoding = (uint32_t)(_this->last_decoded_index + 1);
@@ -251,6 +313,9 @@ auto H264::operator()(uint32_t index) const -> frame::Frame {
         }
       }
     }
+    if (settings.width == 0 && settings.height == 0) { // infer from decoded frame when not specified in settings
+      update_resolution(frame.get(), settings);
+    }
     AVFrame* yFrame = av_frame_clone(frame.get());
     AVFrame* uFrame = av_frame_clone(frame.get());
     AVFrame* vFrame = av_frame_clone(frame.get());
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "vireo/base_h.h"
+#include "vireo/constants.h"
 #include "vireo/decode/types.h"
 #include "vireo/frame/frame.h"
 #include "vireo/functional/media.hpp"
@@ -38,7 +39,7 @@ using namespace vireo::decode;
 class H264 final : public functional::DirectVideo<H264, frame::Frame> {
   std::shared_ptr<struct _H264> _this;
 public:
-  H264(const functional::Video<Sample>& track, uint32_t thread_count = 0);
+  H264(const functional::Video<Sample>& track, uint32_t thread_count = 0, uint32_t cache_size = kDecodeCacheSize, bool fast = false);
   H264(const H264& h264);
   DISALLOW_ASSIGN(H264);
   auto operator()(uint32_t index) const -> frame::Frame;
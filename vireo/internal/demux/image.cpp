@@ -42,7 +42,7 @@ const static uint32_t kImageTimeScaleMs = 1000;
 const static uint32_t kSignatureMaxSize = 8;
 
 struct ImageCoreStorage : public imagecore::ImageReader::Storage {
-  uint32_t offset = 0;
+  uint64_t offset = 0;
   common::Reader reader;
   common::Data32 simple_cache = common::Data32();  // avoid requesting small chunks of data from Reader
   ImageCoreStorage(common::Reader&& reader) : reader(move(reader)) {}
@@ -52,12 +52,12 @@ struct ImageCoreStorage : public imagecore::ImageReader::Storage {
       return 0;
     }
     THROW_IF(numBytes > std::numeric_limits<uint32_t>::max(), Overflow);
-    const uint32_t read_size = std::min((uint32_t)numBytes, reader.size() - offset);
+    const uint32_t read_size = (uint32_t)std::min(numBytes, reader.size() - offset);
     if (read_size) {
       const static uint32_t kMaxCacheSize = 1024;
       if (read_size < kMaxCacheSize) {
         if (read_size > simple_cache.count()) {
-          simple_cache = move(reader.read(offset, min(kMaxCacheSize, reader.size() - offset)));
+          simple_cache = move(reader.read(offset, (uint32_t)min((uint64_t)kMaxCacheSize, reader.size() - offset)));
         }
         memcpy(destBuffer, simple_cache.data() + simple_cache.a(), read_size);
         simple_cache.set_bounds(simple_cache.a() + read_size, simple_cache.b());
@@ -74,13 +74,13 @@ struct ImageCoreStorage : public imagecore::ImageReader::Storage {
   bool seek(int64_t pos, SeekMode mode) {
     if (mode == SeekMode::kSeek_Set) {
       CHECK(offset >= 0);
-      offset = (uint32_t)pos;
+      offset = (uint64_t)pos;
     } else if (mode == SeekMode::kSeek_Current) {
       CHECK((int64_t)offset + pos >= 0);
-      offset = (uint32_t)((int64_t)offset + pos);
+      offset = (uint64_t)((int64_t)offset + pos);
     } else if (mode == SeekMode::kSeek_End) {
       CHECK((int64_t)reader.size() + pos >= 0);
-      offset = (uint32_t)((int64_t)reader.size() + pos);
+      offset = (uint64_t)((int64_t)reader.size() + pos);
     }
     simple_cache.set_bounds(0, 0);
     return std::min(offset, reader.size());
@@ -167,6 +167,7 @@ struct _Image {
 };
 
 Image::Image(common::Reader&& reader) : _this(make_shared<_Image>(move(reader))), track(_this) {
+  THROW_IF(_this->storage.reader.size() > numeric_limits<uint32_t>::max(), Unsafe);  // images are read as a single sample
   if (_this->finish_initialization()) {
     track.set_bounds(0, _this->num_frames);
     track._settings = (settings::Video) {
@@ -188,6 +189,10 @@ Image::Image(Image&& image) : track(_this) {
   image._this = nullptr;
 }
 
+auto Image::io_stats() const -> common::Reader::Stats {
+  return _this->storage.reader.stats();
+}
+
 Image::Track::Track(const std::shared_ptr<_Image>& _this) : _this(_this) {}
 
 Image::Track::Track(const Track& track)
@@ -212,7 +217,7 @@ auto Image::Track::operator()(uint32_t index) const -> Sample {
   bool keyframe = index == 0;
   auto nal = [_this = _this, keyframe]() -> common::Data32 {
     if (keyframe) {
-      return _this->storage.reader.read(0, _this->storage.reader.size());
+      return _this->storage.reader.read(0, (uint32_t)_this->storage.reader.size());
     } else {
       return common::Data32();
     }
@@ -50,6 +50,7 @@ public:
   Image(common::Reader&& reader);
   Image(Image&& image);
   DISALLOW_COPY_AND_ASSIGN(Image);
+  auto io_stats() const -> common::Reader::Stats;
 
   class Track final : public functional::DirectVideo<Track, Sample> {
     std::shared_ptr<_Image> _this;
@@ -693,6 +693,10 @@ MP2TS::MP2TS(MP2TS&& mp2ts)
   mp2ts._this = nullptr;
 }
 
+auto MP2TS::io_stats() const -> common::Reader::Stats {
+  return _this->reader.stats();
+}
+
 MP2TS::VideoTrack::VideoTrack(const std::shared_ptr<_MP2TS>& _mp2ts_this)
   : _this(_mp2ts_this) {
 }
@@ -45,6 +45,7 @@ public:
   MP2TS(common::Reader&& reader);
   MP2TS(MP2TS&& mp2ts);
   DISALLOW_COPY_AND_ASSIGN(MP2TS);
+  auto io_stats() const -> common::Reader::Stats;
 
   class VideoTrack final : public functional::DirectVideo<VideoTrack, Sample> {
     std::shared_ptr<_MP2TS> _this;
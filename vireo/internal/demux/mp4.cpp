@@ -51,18 +51,77 @@ namespace demux {
 
 static const uint32_t kSizeBuffer = 512 * 1024;
 const static uint8_t kNumTracks = 3;
+const static uint32_t kIndexMagic = 0x56494458;  // 'VIDX'
+const static uint8_t kIndexVersion = 3;  // 2: 64-bit file size, 3: moov fingerprint
+
+// Big endian serialization of the sample index
+class IndexWriter {
+  vector<uint8_t> bytes;
+public:
+  template <typename T>
+  void put(const T value) {
+    for (int shift = (sizeof(T) - 1) * CHAR_BIT; shift >= 0; shift -= CHAR_BIT) {
+      bytes.push_back((uint8_t)((uint64_t)value >> shift));
+    }
+  }
+  void put(const common::Data16& data) {
+    put((uint16_t)data.count());
+    bytes.insert(bytes.end(), data.data() + data.a(), data.data() + data.b());
+  }
+  auto data() const -> common::Data32 {
+    THROW_IF(bytes.size() > numeric_limits<uint32_t>::max(), Overflow);
+    const common::Data32 view(bytes.data(), (uint32_t)bytes.size(), nullptr);
+    return common::Data32(view);  // deep copy
+  }
+};
+
+class IndexReader {
+  const uint8_t* ptr;
+  const uint8_t* const end;
+public:
+  IndexReader(const common::Data32& data) : ptr(data.data() + data.a()), end(data.data() + data.b()) {}
+  template <typename T>
+  auto get() -> T {
+    THROW_IF(end - ptr < (ptrdiff_t)sizeof(T), Invalid, "truncated sample index");
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      value = (value << CHAR_BIT) | *ptr++;
+    }
+    return (T)value;
+  }
+  auto get_data16() -> common::Data16 {
+    const uint16_t size = get<uint16_t>();
+    THROW_IF(end - ptr < size, Invalid, "truncated sample index");
+    common::Data16 data(new uint8_t[size], size, [](uint8_t* p) { delete[] p; });
+    memcpy((uint8_t*)data.data(), ptr, size);
+    ptr += size;
+    return move(data);
+  }
+  auto done() const -> bool {
+    return ptr == end;
+  }
+};
 
 struct _MP4 {
   common::Reader reader;
-  unique_ptr<lsmash_root_t, decltype(&lsmash_destroy_root)> root = { nullptr, lsmash_destroy_root };
+  unique_ptr<lsmash_root_t, decltype(&lsmash_destroy_root)> root = { nullptr, lsmash_destroy_root };  // not created when restoring from an index
+  bool initialized = false;
   unique_ptr<lsmash_file_parameters_t> file;
   uint8_t nalu_length_size = 0;
   struct {
     uint32_t timescale = 0;
   } movie;
 
+  struct SampleEntry {  // flattened sample table entry, resolved once at open
+    uint64_t pts;
+    uint64_t dts;
+    uint64_t pos;
+    uint32_t size;
+    bool keyframe;
+  };
+
   struct Track {
-    unique_ptr<lsmash_media_ts_t, decltype(&lsmash_free)> timestamps = { nullptr, lsmash_free };
+    vector<SampleEntry> samples;  // not used for PCM audio, see audio.pcm_samples
     unique_ptr<lsmash_summary_t, function<void(lsmash_summary_t* p)>> summary = { nullptr, [](lsmash_summary_t* p) {
       lsmash_cleanup_summary(p);
     }};
@@ -90,7 +149,6 @@ struct _MP4 {
     uint16_t height = 0;
     settings::Video::Orientation orientation = settings::Video::Orientation::UnknownOrientation;
     unique_ptr<header::SPS_PPS> sps_pps = nullptr;
-    vector<lsmash_media_ts_t> pts_sorted_timestamps;  // to detect open GOPs and only report IDR frames as keyframe (mitigation of l-smash bug)
     uint32_t first_keyframe_index = 0;  // to mark non-decodable non-IDR frames at the beginning (MEDIASERV-4818)
     uint16_t par_width = 0;
     uint16_t par_height = 0;
@@ -433,8 +491,7 @@ struct _MP4 {
           return bytes % (AUDIO_FRAME_SIZE * num_bytes_per_sample) == 0;
         };
         auto save_anchor_sample = [_this = this, &total_bytes, num_bytes_per_sample, &aligned_with_audio_frame_size](lsmash_sample_t anchor_sample, uint32_t size) {
-          THROW_IF(anchor_sample.pos > numeric_limits<uint32_t>::max(), Overflow);
-          uint32_t pos = (uint32_t)anchor_sample.pos;
+          const uint64_t pos = anchor_sample.pos;
           auto nal = [_this, pos, size]() -> common::Data32 {
             auto nal_data = _this->reader.read(pos, size);
             THROW_IF(nal_data.count() != size, ReaderError);
@@ -492,27 +549,39 @@ struct _MP4 {
         lsmash_media_ts_list_t ts_list;
         THROW_IF(lsmash_get_media_timestamps(root.get(), tracks(type).track_ID, &ts_list) != 0, Invalid);
         THROW_IF(!ts_list.timestamp, Invalid);
+        unique_ptr<lsmash_media_ts_t, decltype(&lsmash_free)> timestamps(ts_list.timestamp, lsmash_free);
         CHECK(ts_list.sample_count == tracks(type).sample_count);
         enforce_correct_pts(ts_list);  // Mitigation of MEDIASERV-4739
-        tracks(type).timestamps.reset(ts_list.timestamp);
-      }
-
-      if (type == SampleType::Video) {
-        // Create an additional list of pts sorted timestamps - used for Open GOP detection
-        CHECK(tracks(type).timestamps);
-        vector<lsmash_media_ts_t> pts_sorted_timestamps(tracks(type).timestamps.get(), tracks(type).timestamps.get() + tracks(type).sample_count);
-        sort(pts_sorted_timestamps.begin(), pts_sorted_timestamps.end(), [](const lsmash_media_ts_t& a, const lsmash_media_ts_t& b){ return a.cts < b.cts; });
-        swap(video.pts_sorted_timestamps, pts_sorted_timestamps);
 
-        // Handle non-standard inputs, discard samples at the beginning of the video track until the first keyframe
+        // Flatten the sample table: sample access then only needs the reader, not the l-smash timeline
+        vector<SampleEntry> samples;
+        samples.reserve(tracks(type).sample_count);
         for (uint32_t index = 0; index < tracks(type).sample_count; ++index) {
-          lsmash_sample_property_t sample_property;
-          lsmash_get_sample_property_from_media_timeline(root.get(), tracks(type).track_ID, index + 1, &sample_property);
-          if (sample_property.ra_flags & ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC) {
-            video.first_keyframe_index = index;
-            break;
+          lsmash_sample_t sample;
+          THROW_IF(lsmash_get_sample_info_from_media_timeline(root.get(), tracks(type).track_ID, index + 1, &sample) != 0, Invalid);
+          const lsmash_media_ts_t& media_ts = timestamps.get()[index];
+          samples.push_back((SampleEntry){ media_ts.cts, media_ts.dts, sample.pos, sample.length, (bool)(sample.prop.ra_flags & ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC) });
+        }
+
+        if (type == SampleType::Video) {
+          // Handle non-standard inputs, discard samples at the beginning of the video track until the first keyframe
+          for (uint32_t index = 0; index < tracks(type).sample_count; ++index) {
+            if (samples[index].keyframe) {
+              video.first_keyframe_index = index;
+              break;
+            }
+          }
+
+          // Detect open GOPs and only report IDR frames as keyframe (mitigation of l-smash bug)
+          // First frame is always assumed to be an IDR frame
+          vector<lsmash_media_ts_t> pts_sorted_timestamps(timestamps.get(), timestamps.get() + tracks(type).sample_count);
+          sort(pts_sorted_timestamps.begin(), pts_sorted_timestamps.end(), [](const lsmash_media_ts_t& a, const lsmash_media_ts_t& b){ return a.cts < b.cts; });
+          for (uint32_t index = video.first_keyframe_index + 1; index < tracks(type).sample_count; ++index) {
+            samples[index].keyframe = samples[index].keyframe & (pts_sorted_timestamps[index].cts == samples[index].pts);
+            samples[index].keyframe = samples[index].keyframe & (pts_sorted_timestamps[index].dts == samples[index].dts);  // TODO: remove this logic once MEDIASERV-4386 is resolved
           }
         }
+        tracks(type).samples = move(samples);
       }
     }
   }
@@ -611,40 +680,27 @@ struct _MP4 {
     return true;
   }
 
+  Sample table_sample(const SampleEntry& entry, const SampleType type) {
+    THROW_IF(entry.pts > std::numeric_limits<int64_t>::max() || entry.dts > std::numeric_limits<int64_t>::max(), Unsupported);
+    const uint64_t pos = entry.pos;
+    const uint32_t size = entry.size;
+    auto nal = [_this = this, pos, size]() -> common::Data32 {
+      // read directly through the reader: no per-sample allocation and memory-backed readers keep the input padding decoders need
+      auto nal_data = _this->reader.read(pos, size);
+      THROW_IF(nal_data.count() != size, ReaderError);
+      return move(nal_data);
+    };
+    return Sample((int64_t)entry.pts, (int64_t)entry.dts, entry.keyframe, type, nal, pos, size);
+  }
+
   Sample video_sample(const uint32_t index) {
-    THROW_IF(!root.get(), Uninitialized);
+    THROW_IF(!initialized, Uninitialized);
     const uint32_t input_index = index + video.first_keyframe_index;
     const SampleType type = SampleType::Video;
-    THROW_IF(input_index >= tracks(type).sample_count, OutOfRange);
-    CHECK(tracks(type).timestamps);
-    const lsmash_media_ts_t& media_ts = tracks(type).timestamps.get()[input_index];
-    THROW_IF(media_ts.cts > std::numeric_limits<int64_t>::max() || media_ts.dts > std::numeric_limits<int64_t>::max(), Unsupported);
-    int64_t pts = media_ts.cts;
-    int64_t dts = media_ts.dts;
-    lsmash_sample_t sample;
-    lsmash_get_sample_info_from_media_timeline(root.get(), tracks(type).track_ID, input_index + 1, &sample);
-    uint32_t pos = (uint32_t)sample.pos;
-    uint32_t size = sample.length;
-    lsmash_sample_property_t sample_property;
-    lsmash_get_sample_property_from_media_timeline(root.get(), tracks(type).track_ID, input_index + 1, &sample_property);
-    bool keyframe = sample_property.ra_flags & ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
-    if (index) {
-      // Add the following checks for key frames to detect open GOPs
-      // But only do the check for index > 0: if first frame is key frame, always assume it an IDR frame
-      THROW_IF(input_index >= video.pts_sorted_timestamps.size(), OutOfRange);
-      keyframe = keyframe & (video.pts_sorted_timestamps[input_index].cts == pts);  // detect open GOPs and only report IDR frames as keyframe
-      keyframe = keyframe & (video.pts_sorted_timestamps[input_index].dts == dts);  // TODO: remove this logic once MEDIASERV-4386 is resolved
-    }
-    THROW_IF(!index && !keyframe, Invalid);
-    auto nal = [_this = this, input_index]() -> common::Data32 {
-      lsmash_sample_t* sample = lsmash_get_sample_from_media_timeline(_this->root.get(), _this->tracks(type).track_ID, input_index + 1);
-      CHECK(sample);
-      common::Data32 data = common::Data32(sample->data, sample->length, [sample](void* p) {
-        lsmash_delete_sample(sample);
-      });
-      return move(data);
-    };
-    return Sample(pts, dts, keyframe, type, nal, pos, size);
+    THROW_IF(input_index >= tracks(type).samples.size(), OutOfRange);
+    const SampleEntry& entry = tracks(type).samples[input_index];
+    THROW_IF(!index && !entry.keyframe, Invalid);
+    return table_sample(entry, type);
   }
 
   vector<ByteRange> get_sei_ranges(common::Data32& data) {
@@ -661,6 +717,176 @@ struct _MP4 {
     }
     return sei_ranges;
   }
+
+  // FNV-1a hash of the moov box, ties a sample index to the contents of the file it was made from
+  auto moov_fingerprint() -> uint64_t {
+    const uint32_t kMoovType = 0x6D6F6F76;  // 'moov'
+    const uint64_t size = reader.size();
+    uint64_t location = 0;
+    while (size - location >= 2 * sizeof(uint32_t)) {
+      const auto header = reader.read(location, (uint32_t)std::min(size - location, (uint64_t)(2 * sizeof(uint32_t) + sizeof(uint64_t))));
+      IndexReader header_reader(header);
+      uint64_t box_size = header_reader.get<uint32_t>();
+      const uint32_t box_type = header_reader.get<uint32_t>();
+      if (box_size == 1) {  // extended size
+        box_size = header_reader.get<uint64_t>();
+      } else if (box_size == 0) {  // implicit, till the end of file
+        box_size = size - location;
+      }
+      THROW_IF(box_size < 2 * sizeof(uint32_t) || box_size > size - location, Invalid);
+      if (box_type == kMoovType) {
+        THROW_IF(box_size > numeric_limits<uint32_t>::max(), Unsafe);
+        const auto moov = reader.read(location, (uint32_t)box_size);
+        THROW_IF(moov.count() != box_size, ReaderError);
+        uint64_t hash = 0xCBF29CE484222325;
+        for (const uint8_t* byte = moov.data() + moov.a(); byte != moov.data() + moov.b(); ++byte) {
+          hash = (hash ^ *byte) * 0x100000001B3;
+        }
+        return hash;
+      }
+      location += box_size;
+    }
+    THROW_IF(true, Invalid, "no moov box");
+  }
+
+  // Everything needed to serve samples once l-smash is done; reading it back skips parsing the moov box
+  auto index() -> common::Data32 {
+    THROW_IF(!initialized, Uninitialized);
+    IndexWriter writer;
+    writer.put(kIndexMagic);
+    writer.put(kIndexVersion);
+    writer.put(reader.size());
+    writer.put(moov_fingerprint());
+    writer.put(nalu_length_size);
+    writer.put(movie.timescale);
+    auto put_entry = [&writer](const SampleEntry& entry) {
+      writer.put(entry.pts);
+      writer.put(entry.dts);
+      writer.put(entry.pos);
+      writer.put(entry.size);
+      writer.put((uint8_t)entry.keyframe);
+    };
+    for (auto type: { SampleType::Video, SampleType::Audio, SampleType::Caption }) {
+      const Track& track = tracks(type);
+      writer.put(track.track_ID);
+      writer.put(track.timescale);
+      writer.put(track.duration);
+      writer.put(track.playback_duration);
+      writer.put(track.sample_count);
+      writer.put((uint32_t)track.edit_boxes.size());
+      for (const auto& edit_box: track.edit_boxes) {
+        writer.put(edit_box.start_pts);
+        writer.put(edit_box.duration_pts);
+        writer.put(edit_box.rate == 1.0f ? (uint8_t)1 : (uint8_t)0);  // MP4 edit boxes are always normal rate
+      }
+      writer.put((uint32_t)track.samples.size());
+      for (const auto& entry: track.samples) {
+        put_entry(entry);
+      }
+    }
+    writer.put((uint8_t)video.codec);
+    writer.put(video.width);
+    writer.put(video.height);
+    writer.put((uint8_t)video.orientation);
+    writer.put(video.first_keyframe_index);
+    writer.put(video.par_width);
+    writer.put(video.par_height);
+    writer.put((uint8_t)(video.sps_pps ? 1 : 0));
+    if (video.sps_pps) {
+      writer.put(video.sps_pps->sps);
+      writer.put(video.sps_pps->pps);
+      writer.put(video.sps_pps->nalu_length_size);
+    }
+    writer.put((uint8_t)audio.codec);
+    writer.put(audio.sample_rate);
+    writer.put(audio.channels);
+    writer.put((uint32_t)audio.pcm_samples.size());
+    for (const auto& sample: audio.pcm_samples) {
+      put_entry((SampleEntry){ (uint64_t)sample.pts, (uint64_t)sample.dts, sample.byte_range.pos, sample.byte_range.size, sample.keyframe });
+    }
+    writer.put((uint8_t)caption.codec);
+    return writer.data();
+  }
+
+  void restore(const common::Data32& index) {
+    IndexReader index_reader(index);
+    THROW_IF(index_reader.get<uint32_t>() != kIndexMagic, Invalid, "not a sample index");
+    THROW_IF(index_reader.get<uint8_t>() != kIndexVersion, Unsupported, "unknown sample index version");
+    THROW_IF(index_reader.get<uint64_t>() != reader.size(), Invalid, "sample index belongs to a different file");
+    THROW_IF(index_reader.get<uint64_t>() != moov_fingerprint(), Invalid, "sample index belongs to a different file");
+    nalu_length_size = index_reader.get<uint8_t>();
+    movie.timescale = index_reader.get<uint32_t>();
+    auto get_entry = [&index_reader, _this = this]() -> SampleEntry {
+      SampleEntry entry;
+      entry.pts = index_reader.get<uint64_t>();
+      entry.dts = index_reader.get<uint64_t>();
+      entry.pos = index_reader.get<uint64_t>();
+      entry.size = index_reader.get<uint32_t>();
+      entry.keyframe = index_reader.get<uint8_t>() != 0;
+      THROW_IF(entry.pos > _this->reader.size() || entry.size > _this->reader.size() - entry.pos, Invalid);
+      return entry;
+    };
+    for (auto type: { SampleType::Video, SampleType::Audio, SampleType::Caption }) {
+      Track& track = tracks(type);
+      track.track_ID = index_reader.get<uint32_t>();
+      track.timescale = index_reader.get<uint32_t>();
+      track.duration = index_reader.get<uint64_t>();
+      track.playback_duration = index_reader.get<uint64_t>();
+      track.sample_count = index_reader.get<uint32_t>();
+      THROW_IF(track.sample_count >= security::kMaxSampleCount, Unsafe);
+      const uint32_t num_edits = index_reader.get<uint32_t>();
+      THROW_IF(num_edits > 60, Unsafe);  // same limit as when parsing edit lists
+      for (uint32_t i = 0; i < num_edits; ++i) {
+        const int64_t start_pts = index_reader.get<int64_t>();
+        const uint64_t duration_pts = index_reader.get<uint64_t>();
+        THROW_IF(index_reader.get<uint8_t>() != 1, Invalid);
+        track.edit_boxes.push_back(common::EditBox(start_pts, duration_pts, 1.0f, type));
+      }
+      const uint32_t num_samples = index_reader.get<uint32_t>();
+      THROW_IF(num_samples >= security::kMaxSampleCount, Unsafe);
+      for (uint32_t i = 0; i < num_samples; ++i) {
+        track.samples.push_back(get_entry());
+      }
+    }
+    const uint8_t video_codec = index_reader.get<uint8_t>();
+    THROW_IF(video_codec > settings::Video::Codec::TIFF, Invalid);
+    video.codec = (settings::Video::Codec)video_codec;
+    video.width = index_reader.get<uint16_t>();
+    video.height = index_reader.get<uint16_t>();
+    const uint8_t orientation = index_reader.get<uint8_t>();
+    THROW_IF(orientation > settings::Video::Orientation::UnknownOrientation, Invalid);
+    video.orientation = (settings::Video::Orientation)orientation;
+    video.first_keyframe_index = index_reader.get<uint32_t>();
+    video.par_width = index_reader.get<uint16_t>();
+    video.par_height = index_reader.get<uint16_t>();
+    if (index_reader.get<uint8_t>()) {
+      auto sps = index_reader.get_data16();
+      auto pps = index_reader.get_data16();
+      video.sps_pps.reset(new header::SPS_PPS(sps, pps, index_reader.get<uint8_t>()));
+    }
+    const uint8_t audio_codec = index_reader.get<uint8_t>();
+    THROW_IF(audio_codec > settings::Audio::Codec::PCM_S24BE, Invalid);
+    audio.codec = (settings::Audio::Codec)audio_codec;
+    audio.sample_rate = index_reader.get<uint32_t>();
+    audio.channels = index_reader.get<uint8_t>();
+    const uint32_t num_pcm_samples = index_reader.get<uint32_t>();
+    THROW_IF(num_pcm_samples >= security::kMaxSampleCount, Unsafe);
+    for (uint32_t i = 0; i < num_pcm_samples; ++i) {
+      audio.pcm_samples.push_back(table_sample(get_entry(), SampleType::Audio));
+    }
+    const uint8_t caption_codec = index_reader.get<uint8_t>();
+    THROW_IF(caption_codec > settings::Caption::Codec::Unknown, Invalid);
+    caption.codec = (settings::Caption::Codec)caption_codec;
+    THROW_IF(!index_reader.done(), Invalid, "trailing bytes in sample index");
+
+    const Track& video_track = tracks(SampleType::Video);
+    const Track& audio_track = tracks(SampleType::Audio);
+    THROW_IF(video_track.samples.size() != video_track.sample_count, Invalid);
+    THROW_IF(video_track.sample_count && video.first_keyframe_index >= video_track.sample_count, Invalid);
+    THROW_IF(video_track.track_ID && !video.sps_pps, Invalid);
+    THROW_IF((settings::Audio::IsPCM(audio.codec) ? audio.pcm_samples.size() : audio_track.samples.size()) != audio_track.sample_count, Invalid);
+    initialized = true;
+  }
 };
 
 MP4::MP4(common::Reader&& reader)
@@ -685,42 +911,8 @@ MP4::MP4(common::Reader&& reader)
   THROW_IF(lsmash_read_file(file, _this->file.get()) < 0, Invalid);
 
   if (_this->finish_initialization()) {
-    video_track.set_bounds(0, _this->tracks(SampleType::Video).sample_count - _this->video.first_keyframe_index);
-    audio_track.set_bounds(0, _this->tracks(SampleType::Audio).sample_count);
-    if (_this->video.codec == settings::Video::Codec::H264) {
-      caption_track.set_bounds(video_track.a(), video_track.b()); // don't have caption information yet, use video bounds to set caption bounds
-    } else {
-      caption_track.set_bounds(0, 0);
-    }
-
-    if (_this->tracks(SampleType::Video).track_ID) {
-      CHECK(_this->video.sps_pps.get());
-      video_track._settings = (settings::Video){
-        _this->video.codec,
-        _this->video.width,
-        _this->video.height,
-        _this->video.par_width,
-        _this->video.par_height,
-        _this->tracks(SampleType::Video).timescale,
-        _this->video.orientation,
-        *_this->video.sps_pps
-      };
-
-      caption_track._settings = (settings::Caption){
-        _this->caption.codec,
-        _this->tracks(SampleType::Caption).timescale
-      };
-    }
-
-    if (_this->tracks(SampleType::Audio).track_ID) {
-      audio_track._settings = (settings::Audio){
-        _this->audio.codec,
-        _this->tracks(SampleType::Audio).timescale,
-        _this->audio.sample_rate,
-        _this->audio.channels,
-        0
-      };
-    }
+    _this->initialized = true;
+    init_tracks();
   } else {
     _this->root.reset(nullptr);
     _this->video.sps_pps.reset(nullptr);
@@ -728,12 +920,65 @@ MP4::MP4(common::Reader&& reader)
   }
 }
 
+MP4::MP4(common::Reader&& reader, const common::Data32& index)
+  : _this(make_shared<_MP4>(move(reader))), audio_track(_this), video_track(_this), caption_track(_this) {
+  _this->restore(index);
+  init_tracks();
+}
+
+auto MP4::init_tracks() -> void {
+  video_track.set_bounds(0, _this->tracks(SampleType::Video).sample_count - _this->video.first_keyframe_index);
+  audio_track.set_bounds(0, _this->tracks(SampleType::Audio).sample_count);
+  if (_this->video.codec == settings::Video::Codec::H264) {
+    caption_track.set_bounds(video_track.a(), video_track.b()); // don't have caption information yet, use video bounds to set caption bounds
+  } else {
+    caption_track.set_bounds(0, 0);
+  }
+
+  if (_this->tracks(SampleType::Video).track_ID) {
+    CHECK(_this->video.sps_pps.get());
+    video_track._settings = (settings::Video){
+      _this->video.codec,
+      _this->video.width,
+      _this->video.height,
+      _this->video.par_width,
+      _this->video.par_height,
+      _this->tracks(SampleType::Video).timescale,
+      _this->video.orientation,
+      *_this->video.sps_pps
+    };
+
+    caption_track._settings = (settings::Caption){
+      _this->caption.codec,
+      _this->tracks(SampleType::Caption).timescale
+    };
+  }
+
+  if (_this->tracks(SampleType::Audio).track_ID) {
+    audio_track._settings = (settings::Audio){
+      _this->audio.codec,
+      _this->tracks(SampleType::Audio).timescale,
+      _this->audio.sample_rate,
+      _this->audio.channels,
+      0
+    };
+  }
+}
+
 MP4::MP4(MP4&& mp4)
   : audio_track(_this), video_track(_this), caption_track(_this) {
   _this = mp4._this;
   mp4._this = nullptr;
 }
 
+auto MP4::index() const -> common::Data32 {
+  return _this->index();
+}
+
+auto MP4::io_stats() const -> common::Reader::Stats {
+  return _this->reader.stats();
+}
+
 MP4::VideoTrack::VideoTrack(const std::shared_ptr<_MP4>& _mp4_this)
   : _this(_mp4_this) {}
 
@@ -741,12 +986,12 @@ MP4::VideoTrack::VideoTrack(const VideoTrack& video_track)
   : functional::DirectVideo<VideoTrack, Sample>(video_track.a(), video_track.b()), _this(video_track._this) {}
 
 auto MP4::VideoTrack::duration() const -> uint64_t {
-  THROW_IF(!_this->root.get(), Uninitialized);
+  THROW_IF(!_this->initialized, Uninitialized);
   return _this->tracks(SampleType::Video).duration;
 }
 
 auto MP4::VideoTrack::edit_boxes() const -> const vector<common::EditBox>& {
-  THROW_IF(!_this->root.get(), Uninitialized);
+  THROW_IF(!_this->initialized, Uninitialized);
   return _this->tracks(SampleType::Video).edit_boxes;
 }
 
@@ -755,7 +1000,7 @@ auto MP4::VideoTrack::fps() const -> float {
 }
 
 auto MP4::VideoTrack::operator()(const uint32_t index) const -> Sample {
-  THROW_IF(!_this->root.get(), Uninitialized);
+  THROW_IF(!_this->initialized, Uninitialized);
   THROW_IF(index >= b(), OutOfRange);
   auto sample = _this->video_sample(index);
   auto nal = [_this = _this, sample]() -> common::Data32 {
@@ -804,43 +1049,29 @@ MP4::AudioTrack::AudioTrack(const AudioTrack& audio_track)
   : functional::DirectAudio<AudioTrack, Sample>(audio_track.a(), audio_track.b()), _this(audio_track._this) {}
 
 auto MP4::AudioTrack::duration() const -> uint64_t {
-  THROW_IF(!_this->root.get(), Uninitialized);
+  THROW_IF(!_this->initialized, Uninitialized);
   return _this->tracks(SampleType::Audio).duration;
 }
 
 auto MP4::AudioTrack::edit_boxes() const -> const vector<common::EditBox>& {
-  THROW_IF(!_this->root.get(), Uninitialized);
+  THROW_IF(!_this->initialized, Uninitialized);
   return _this->tracks(SampleType::Audio).edit_boxes;
 }
 
 auto MP4::AudioTrack::operator()(const uint32_t index) const -> Sample {
-  THROW_IF(!_this->root.get(), Uninitialized);
+  THROW_IF(!_this->initialized, Uninitialized);
   THROW_IF(index >= b(), OutOfRange);
   const SampleType type = SampleType::Audio;
   THROW_IF(index >= _this->tracks(type).sample_count, OutOfRange);
   if (settings::Audio::IsPCM(_this->audio.codec)) {
     return _this->audio.pcm_samples[index];
   } else {
-    CHECK(_this->tracks(type).timestamps);
-    const lsmash_media_ts_t& media_ts = _this->tracks(type).timestamps.get()[index];
-    THROW_IF(media_ts.cts > std::numeric_limits<int64_t>::max() || media_ts.dts > std::numeric_limits<int64_t>::max(), Unsupported);
-    int64_t pts = media_ts.cts;
-    int64_t dts = media_ts.dts;
-    lsmash_sample_t sample;
-    lsmash_get_sample_info_from_media_timeline(_this->root.get(), _this->tracks(type).track_ID, index + 1, &sample);
-    uint32_t pos = (uint32_t)sample.pos;
-    uint32_t size = sample.length;
-    lsmash_sample_property_t sample_property;
-    lsmash_get_sample_property_from_media_timeline(_this->root.get(), _this->tracks(type).track_ID, index + 1, &sample_property);
-    bool keyframe = sample_property.ra_flags & ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
-    auto nal = [_this = _this, index]() -> common::Data32 {
-      lsmash_sample_t* sample = lsmash_get_sample_from_media_timeline(_this->root.get(), _this->tracks(type).track_ID, index + 1);
-      CHECK(sample);
-      return common::Data32(sample->data, sample->length, [sample](void* p) {
-        lsmash_delete_sample(sample);
-      });
+    THROW_IF(index >= _this->tracks(type).samples.size(), OutOfRange);
+    auto sample = _this->table_sample(_this->tracks(type).samples[index], type);
+    auto nal = [_this = _this, sample]() -> common::Data32 {
+      return sample.nal();
     };
-    return Sample(pts, dts, keyframe, type, nal, pos, size);
+    return Sample(sample.pts, sample.dts, sample.keyframe, type, nal, sample.byte_range.pos, sample.byte_range.size);
   }
 }
 
@@ -851,17 +1082,17 @@ MP4::CaptionTrack::CaptionTrack(const CaptionTrack& caption_track)
   : functional::DirectCaption<CaptionTrack, Sample>(caption_track.a(), caption_track.b()), _this(caption_track._this) {}
 
 auto MP4::CaptionTrack::duration() const -> uint64_t {
-  THROW_IF(!_this->root.get(), Uninitialized);
+  THROW_IF(!_this->initialized, Uninitialized);
   return _this->tracks(SampleType::Caption).duration;
 }
 
 auto MP4::CaptionTrack::edit_boxes() const -> const vector<common::EditBox>& {
-  THROW_IF(!_this->root.get(), Uninitialized);
+  THROW_IF(!_this->initialized, Uninitialized);
   return _this->tracks(SampleType::Caption).edit_boxes;
 }
 
 auto MP4::CaptionTrack::operator()(const uint32_t index) const -> Sample {
-  THROW_IF(!_this->root.get(), Uninitialized);
+  THROW_IF(!_this->initialized, Uninitialized);
   THROW_IF(index >= b(), OutOfRange);
   auto sample = _this->video_sample(index);
   auto nal = [_this = _this, sample]() -> common::Data32 {
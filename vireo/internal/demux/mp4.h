@@ -39,8 +39,11 @@ class MP4 final {
   std::shared_ptr<struct _MP4> _this = nullptr;
 public:
   MP4(common::Reader&& reader);
+  MP4(common::Reader&& reader, const common::Data32& index);  // restores the tracks from index() instead of parsing the file again
   MP4(MP4&& mp4);
   DISALLOW_COPY_AND_ASSIGN(MP4);
+  auto index() const -> common::Data32;  // compact binary sample index, tied to the file it was created from
+  auto io_stats() const -> common::Reader::Stats;
 
   class VideoTrack final : public functional::DirectVideo<VideoTrack, Sample> {
     std::shared_ptr<_MP4> _this;
@@ -78,6 +81,9 @@ public:
     auto edit_boxes() const -> const vector<common::EditBox>&;
     auto operator()(uint32_t index) const -> Sample;
   } caption_track;
+
+private:
+  auto init_tracks() -> void;
 };
 
 }}}
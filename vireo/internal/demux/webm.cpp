@@ -61,7 +61,7 @@ struct WebMReader : public mkvparser::IMkvReader {
       return -1;
     }
     if (len) {
-      common::Data32 data = reader.read((uint32_t)offset, (uint32_t)len);
+      common::Data32 data = reader.read((uint64_t)offset, (uint32_t)len);
       THROW_IF(data.count() != len, ReaderError);
       memcpy(buffer, data.data(), len);
     }
@@ -274,6 +274,10 @@ WebM::WebM(WebM&& webm) : audio_track(_this), video_track(_this) {
   webm._this = NULL;
 }
 
+auto WebM::io_stats() const -> common::Reader::Stats {
+  return _this->reader.reader.stats();
+}
+
 WebM::VideoTrack::VideoTrack(const std::shared_ptr<_WebM>& _webm_this) : _this(_webm_this) {}
 
 WebM::VideoTrack::VideoTrack(const VideoTrack& video_track)
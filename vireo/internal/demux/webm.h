@@ -44,6 +44,7 @@ public:
   WebM(common::Reader&& reader);
   WebM(WebM&& webm);
   DISALLOW_COPY_AND_ASSIGN(WebM);
+  auto io_stats() const -> common::Reader::Stats;
 
   class VideoTrack final : public functional::DirectVideo<VideoTrack, Sample> {
     std::shared_ptr<_WebM> _this;
@@ -0,0 +1,129 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "imagecore/formats/writer.h"
+#undef LOCAL
+#include "vireo/base_h.h"
+#include "vireo/common/data.h"
+#include "vireo/error/error.h"
+#include "vireo/functional/media.hpp"
+
+namespace vireo {
+namespace internal {
+namespace encode {
+
+// Image writer output that keeps its buffer when rewound, so that a worker does not reallocate it for every image
+class Storage final : public imagecore::ImageWriter::Storage {
+  vector<uint8_t> bytes;
+public:
+  virtual uint64_t write(const void* source, uint64_t num_bytes) {
+    bytes.insert(bytes.end(), (const uint8_t*)source, (const uint8_t*)source + num_bytes);
+    return num_bytes;
+  }
+  virtual bool asFile(FILE*& file) { return false; }
+  virtual bool asBuffer(uint8_t*& buffer, uint64_t& length) {
+    buffer = bytes.data();
+    length = bytes.size();
+    return true;
+  }
+  virtual uint64_t totalBytesWritten() { return bytes.size(); }
+  virtual void flush() {}
+  auto rewind() -> void { bytes.clear(); }
+  auto data() const -> common::Data32 {
+    THROW_IF(bytes.size() > numeric_limits<uint32_t>::max(), Overflow);
+    const common::Data32 view(bytes.data(), (uint32_t)bytes.size(), nullptr);
+    return common::Data32(view);  // deep copy, the buffer stays with the worker
+  }
+};
+
+// Encodes frames [index, index + count) on up to thread_count workers (0: one per core) and returns the encoded images in index order.
+// Each worker writes every image it encodes through its own Storage and ImageWriter of the given format, encode returns false
+// when the write failed, the worker then creates a new writer for its next image.
+// Frames are pulled one at a time under a lock since they are typically produced by a decoder that is not thread safe:
+// whatever computes the frames (decoding, scaling, ...) runs one frame at a time, only the image encoding runs in parallel.
+template <typename Frame, typename Encode>
+auto encode_batch(const functional::Video<Frame>& frames, uint32_t index, uint32_t count, uint32_t thread_count, EImageFormat format, const Encode& encode) -> vector<common::Data32> {
+  THROW_IF(index + count > frames.count() || index + count < index, OutOfRange);
+  if (!thread_count) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+  }
+  vector<common::Data32> images(count);
+  std::mutex lock;
+  uint32_t next = 0;
+  std::exception_ptr error = nullptr;
+  auto work = [&frames, index, count, format, &encode, &images, &lock, &next, &error]() {
+    Storage storage;
+    unique_ptr<imagecore::ImageWriter> writer;
+    try {
+      while (true) {
+        uint32_t i;
+        unique_ptr<Frame> frame;
+        {
+          std::lock_guard<std::mutex> guard(lock);
+          if (next == count) {
+            break;
+          }
+          i = next++;
+          frame.reset(new Frame(frames(index + i)));
+        }
+        if (!writer) {
+          writer.reset(imagecore::ImageWriter::createWithFormat(format, &storage));
+          CHECK(writer);
+        }
+        storage.rewind();
+        if (!encode(*frame, *writer)) {
+          writer.reset();
+        }
+        images[i] = storage.data();
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> guard(lock);
+      if (!error) {
+        error = std::current_exception();
+      }
+      next = count;
+    }
+  };
+  vector<std::thread> workers;
+  for (uint32_t i = 1; i < std::min(thread_count, count); ++i) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto& worker: workers) {
+    worker.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return images;
+}
+
+}}}
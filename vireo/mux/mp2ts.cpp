@@ -29,6 +29,7 @@ extern "C" {
 }
 #include "vireo/base_cpp.h"
 #include "vireo/common/math.h"
+#include "vireo/common/rope.h"
 #include "vireo/common/security.h"
 #include "vireo/constants.h"
 #include "vireo/encode/util.h"
@@ -54,7 +55,6 @@ const static uint32_t kNALUDelimiterSize = 6;
 
 struct _MP2TS {
   static const size_t kSize_Buffer = 4 * 1024;
-  static const size_t kSize_Default = 512 * 1024;
   unique_ptr<AVFormatContext, function<void(AVFormatContext*)>> format_context = { nullptr, [](AVFormatContext* p) {
     if (p->pb) {
       av_free(p->pb);
@@ -62,7 +62,7 @@ struct _MP2TS {
     }
     avformat_free_context(p);
   }};
-  unique_ptr<common::Data32> movie = nullptr;
+  unique_ptr<common::Rope> movie = nullptr;
   common::Data16 buffer = common::Data16((uint8_t*)av_malloc(kSize_Buffer), kSize_Buffer, av_free);
 
   uint8_t nalu_length_size;
@@ -488,7 +488,6 @@ struct _MP2TS {
       );
 
       CHECK(av_write_trailer(format_context.get()) == 0);
-      movie->set_bounds(0, movie->b());
       finalized = true;
     }
   }
@@ -512,30 +511,18 @@ MP2TS::MP2TS(const functional::Audio<encode::Sample>& audio, const functional::V
       return 0;
     }
     _MP2TS* _this = (_MP2TS*)opaque;
-    if (!_this->movie || size + _this->movie->a() > _this->movie->capacity()) {
-      const uint32_t new_capacity = _this->movie ? _this->movie->capacity() + common::align_divide(size + _this->movie->a() - _this->movie->capacity(), (uint32_t)_MP2TS::kSize_Default) : common::align_divide(size, (int)_MP2TS::kSize_Default);
-      common::Data32* new_data = new common::Data32(new uint8_t[new_capacity], new_capacity, [](uint8_t* p) { delete[] p; });
-      THROW_IF(!new_data->data(), OutOfMemory);
-      if (_this->movie) {
-        new_data->set_bounds(_this->movie->a(), _this->movie->b());
-        memcpy((uint8_t*)new_data->data(), _this->movie->data(), _this->movie->b());
-      } else {
-        new_data->set_bounds(0, 0);
-      }
-      _this->movie.reset(new_data);
+    if (!_this->movie) {
+      _this->movie.reset(new common::Rope());
     }
-    memcpy((uint8_t*)_this->movie->data() + _this->movie->a(), buf, size);
-    _this->movie->set_bounds(_this->movie->a() + (uint32_t)size,
-                                   std::max(_this->movie->b(), _this->movie->a() + (uint32_t)size));
+    _this->movie->write(buf, (uint32_t)size);
     return size;
   };
   auto seek_func = [] (void* opaque, int64_t offset, int whence) -> int64_t {
     _MP2TS* _this = (_MP2TS*)opaque;
     if (whence == SEEK_SET) {
-      THROW_IF(offset < 0 || offset > _this->movie->b(), OutOfRange);
-      _MP2TS* _this = (_MP2TS*)opaque;
-      _this->movie->set_bounds((uint32_t)offset, _this->movie->b());
-      return (int)offset;
+      THROW_IF(offset < 0 || (uint64_t)offset > _this->movie->size(), OutOfRange);
+      _this->movie->seek((uint64_t)offset);
+      return offset;
     }
     return 0;
   };
@@ -636,7 +623,7 @@ MP2TS::MP2TS(const functional::Audio<encode::Sample>& audio, const functional::V
     THROW_IF(!_this->initialized, Uninitialized);
     _this->flush();
     CHECK(_this->movie.get());
-    return *_this->movie.get();
+    return _this->movie->data();
   };
 }
 
@@ -645,4 +632,11 @@ MP2TS::MP2TS(MP2TS&& mp2ts)
   mp2ts._this = nullptr;
 }
 
+auto MP2TS::blocks() -> vector<common::Data32> {
+  THROW_IF(!_this->initialized, Uninitialized);
+  _this->flush();
+  CHECK(_this->movie.get());
+  return _this->movie->blocks();
+}
+
 }}
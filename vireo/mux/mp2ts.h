@@ -39,6 +39,7 @@ public:
   MP2TS(const functional::Audio<encode::Sample>& audio, const functional::Video<encode::Sample>& video, const functional::Caption<encode::Sample>& caption);
   MP2TS(MP2TS&& mp2ts);
   DISALLOW_COPY_AND_ASSIGN(MP2TS);
+  auto blocks() -> vector<common::Data32>;  // same contents as operator()(), as views into the muxer's buffer (e.g. for writev) that keep it alive
 };
 
 }}
@@ -22,6 +22,10 @@
  * SOFTWARE.
  */
 
+#include <deque>
+#include <errno.h>
+#include <stdio.h>
+
 extern "C" {
 #include "lsmash.h"
 }
@@ -29,6 +33,7 @@ extern "C" {
 #include "vireo/common/enum.hpp"
 #include "vireo/common/math.h"
 #include "vireo/common/ref.h"
+#include "vireo/common/rope.h"
 #include "vireo/common/security.h"
 #include "vireo/constants.h"
 #include "vireo/encode/util.h"
@@ -44,6 +49,223 @@ const static uint8_t kNumTracks = 2;
 namespace vireo {
 namespace mux {
 
+// Hands a regular movie (ftyp | mdat | moov, no faststart) over to a writer while l-smash writes it.
+// The size of mdat is only known once all samples are written, so samples are handed over in several mdat boxes
+// of about batch_size bytes each, cut on chunk boundaries, and the chunk offsets in moov are shifted for the
+// extra mdat headers before it is handed over. Only the bytes of the current batch are kept in memory.
+struct MP4Stream {
+  static const uint32_t kSize_BoxHeader = 8;
+  std::function<void(const common::Data32& data)> writer;
+  const uint64_t batch_size;
+  vector<uint8_t> pending;  // written by l-smash but not handed over yet, starting at pending_offset
+  uint64_t pending_offset = 0;
+  uint64_t position = 0;
+  uint64_t size = 0;
+  uint64_t scanned = 0;  // top level boxes are parsed up to here until mdat is found
+  uint64_t header_start = 0;  // mdat header, including the free box l-smash may reserve in front of it for a large size
+  uint64_t mdat_start = 0;
+  uint64_t payload_start = 0;  // 0 until mdat is found
+  uint64_t batch_start = 0;
+  bool first_batch = true;
+  vector<uint64_t> chunk_offsets;  // relative to payload_start, in the order l-smash writes the chunks
+  uint64_t chunks_size = 0;
+  vector<uint64_t> cuts;  // l-smash offsets in front of which an extra mdat header was inserted
+
+  MP4Stream(const std::function<void(const common::Data32& data)>& writer, uint64_t batch_size) : writer(writer), batch_size(batch_size) {}
+
+  static uint64_t Field(const uint8_t* bytes, uint32_t size) {  // big endian
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      value = (value << 8) | bytes[i];
+    }
+    return value;
+  }
+
+  static void SetField(uint8_t* bytes, uint32_t size, uint64_t value) {  // big endian
+    for (uint32_t i = size; i > 0; --i) {
+      bytes[i - 1] = (uint8_t)(value & 0xFF);
+      value >>= 8;
+    }
+  }
+
+  auto bytes(uint64_t offset) -> uint8_t* {
+    CHECK(offset >= pending_offset && offset <= pending_offset + pending.size());
+    return pending.data() + (offset - pending_offset);
+  }
+
+  auto hand_over(const uint8_t* bytes, uint64_t size) -> void {
+    while (size) {
+      const uint32_t length = (uint32_t)std::min(size, (uint64_t)std::numeric_limits<uint32_t>::max());
+      writer(common::Data32(bytes, length, nullptr));
+      bytes += length;
+      size -= length;
+    }
+  }
+
+  auto release(uint64_t offset) -> void {  // hands over pending bytes up to offset
+    CHECK(offset >= pending_offset && offset <= size);
+    hand_over(pending.data(), offset - pending_offset);
+    pending.erase(pending.begin(), pending.begin() + (offset - pending_offset));
+    pending_offset = offset;
+  }
+
+  auto add_chunk(uint32_t chunk_size) -> void {  // has to be called for every chunk, in the order l-smash writes them
+    chunk_offsets.push_back(chunks_size);
+    chunks_size += chunk_size;
+  }
+
+  auto write(const uint8_t* buf, uint32_t buf_size) -> void {
+    if (position != size) {
+      // the only thing l-smash goes back to is the mdat header, to set its size: the mdat boxes handed over are sized here instead
+      THROW_IF(!payload_start || position < header_start || position + buf_size > payload_start, Unsupported, "Movie cannot be rewritten while streaming");
+      position += buf_size;
+      return;
+    }
+    pending.insert(pending.end(), buf, buf + buf_size);
+    position += buf_size;
+    size = position;
+    if (!payload_start) {
+      find_payload();
+    }
+    if (payload_start) {
+      cut_batches();
+    }
+  }
+
+  auto seek(int64_t offset, int whence) -> int64_t {
+    if (whence == SEEK_CUR) {
+      offset += (int64_t)position;
+    } else if (whence == SEEK_END) {
+      offset += (int64_t)size;
+    }
+    THROW_IF(offset < 0 || (uint64_t)offset > size, OutOfRange);
+    position = (uint64_t)offset;
+    return offset;
+  }
+
+  auto find_payload() -> void {
+    while (scanned <= size && size - scanned >= kSize_BoxHeader) {
+      const uint8_t* header = bytes(scanned);
+      if (memcmp(header + sizeof(uint32_t), "mdat", 4) == 0) {
+        const bool extended = Field(header, sizeof(uint32_t)) == 1;
+        const uint64_t header_size = kSize_BoxHeader + (extended ? sizeof(uint64_t) : 0);
+        if (size - scanned < header_size) {
+          return;
+        }
+        mdat_start = scanned;
+        payload_start = scanned + header_size;
+        batch_start = payload_start;
+        return;
+      }
+      const uint64_t box_size = Field(header, sizeof(uint32_t));
+      THROW_IF(box_size < kSize_BoxHeader, Invalid);
+      const bool reserved = memcmp(header + sizeof(uint32_t), "free", 4) == 0 && box_size == kSize_BoxHeader;
+      header_start = reserved ? scanned : scanned + box_size;
+      scanned += box_size;
+    }
+  }
+
+  auto emit_batch(uint64_t end) -> void {  // hands over the samples in [batch_start, end) as one mdat box
+    const uint64_t batch_payload = end - batch_start;
+    if (first_batch) {  // l-smash mdat header is still pending, size it for this batch
+      uint8_t* header = bytes(mdat_start);
+      if (payload_start - mdat_start == kSize_BoxHeader) {
+        THROW_IF(kSize_BoxHeader + batch_payload > std::numeric_limits<uint32_t>::max(), Overflow);
+        SetField(header, sizeof(uint32_t), kSize_BoxHeader + batch_payload);
+      } else {
+        SetField(header, sizeof(uint32_t), 1);
+        SetField(header + kSize_BoxHeader, sizeof(uint64_t), kSize_BoxHeader + sizeof(uint64_t) + batch_payload);
+      }
+      first_batch = false;
+    } else {
+      THROW_IF(kSize_BoxHeader + batch_payload > std::numeric_limits<uint32_t>::max(), Overflow);
+      uint8_t header[kSize_BoxHeader];
+      SetField(header, sizeof(uint32_t), kSize_BoxHeader + batch_payload);
+      memcpy(header + sizeof(uint32_t), "mdat", 4);
+      hand_over(header, kSize_BoxHeader);
+      cuts.push_back(batch_start);
+    }
+    release(end);
+    batch_start = end;
+  }
+
+  auto cut_batches() -> void {
+    while (size - batch_start >= batch_size) {
+      // last chunk boundary that is already written
+      auto next = upper_bound(chunk_offsets.begin(), chunk_offsets.end(), size - payload_start);
+      if (next == chunk_offsets.begin()) {
+        return;
+      }
+      const uint64_t end = payload_start + *(next - 1);
+      if (end <= batch_start) {
+        return;
+      }
+      emit_batch(end);
+    }
+  }
+
+  auto shift(uint64_t offset) const -> uint64_t {  // offset in the file handed over for a chunk offset written by l-smash
+    THROW_IF(offset < payload_start || !binary_search(chunk_offsets.begin(), chunk_offsets.end(), offset - payload_start), Invalid, "Chunk offset does not match the streamed samples");
+    const auto num_cuts = upper_bound(cuts.begin(), cuts.end(), offset) - cuts.begin();
+    return offset + num_cuts * kSize_BoxHeader;
+  }
+
+  auto patch_chunk_offsets(uint8_t* boxes, uint64_t boxes_size) -> void {
+    uint64_t location = 0;
+    while (location < boxes_size) {
+      uint8_t* box = boxes + location;
+      THROW_IF(boxes_size - location < kSize_BoxHeader, Invalid);
+      uint64_t box_size = Field(box, sizeof(uint32_t));
+      uint64_t header_size = kSize_BoxHeader;
+      if (box_size == 1) {
+        THROW_IF(boxes_size - location < kSize_BoxHeader + sizeof(uint64_t), Invalid);
+        box_size = Field(box + kSize_BoxHeader, sizeof(uint64_t));
+        header_size += sizeof(uint64_t);
+      } else if (box_size == 0) {
+        box_size = boxes_size - location;
+      }
+      THROW_IF(box_size < header_size || box_size > boxes_size - location, Invalid);
+      const char* type = (const char*)box + sizeof(uint32_t);
+      if (!memcmp(type, "trak", 4) || !memcmp(type, "mdia", 4) || !memcmp(type, "minf", 4) || !memcmp(type, "stbl", 4)) {
+        patch_chunk_offsets(box + header_size, box_size - header_size);
+      } else if (!memcmp(type, "stco", 4) || !memcmp(type, "co64", 4)) {
+        const uint32_t entry_size = memcmp(type, "stco", 4) ? sizeof(uint64_t) : sizeof(uint32_t);
+        const uint32_t kSize_FullBoxFields = 2 * sizeof(uint32_t);  // version / flags, entry count
+        THROW_IF(box_size - header_size < kSize_FullBoxFields, Invalid);
+        uint8_t* entries = box + header_size + kSize_FullBoxFields;
+        const uint64_t num_entries = Field(entries - sizeof(uint32_t), sizeof(uint32_t));
+        THROW_IF(num_entries * entry_size > box_size - header_size - kSize_FullBoxFields, Invalid);
+        for (uint64_t i = 0; i < num_entries; ++i) {
+          const uint64_t offset = shift(Field(entries + i * entry_size, entry_size));
+          THROW_IF(entry_size == sizeof(uint32_t) && offset > std::numeric_limits<uint32_t>::max(), Overflow);
+          SetField(entries + i * entry_size, entry_size, offset);
+        }
+      }
+      location += box_size;
+    }
+  }
+
+  auto finish() -> void {  // l-smash is done writing: hands over the remaining samples and the boxes following them
+    THROW_IF(!payload_start, Invalid);
+    const uint64_t payload_end = payload_start + chunks_size;
+    THROW_IF(payload_end > size, Invalid);
+    if (first_batch || payload_end > batch_start) {
+      emit_batch(payload_end);
+    }
+    for (uint64_t location = payload_end; location < size;) {
+      THROW_IF(size - location < kSize_BoxHeader, Invalid);
+      uint8_t* box = bytes(location);
+      const uint64_t box_size = Field(box, sizeof(uint32_t));
+      THROW_IF(box_size < kSize_BoxHeader || box_size > size - location, Invalid);
+      if (!memcmp(box + sizeof(uint32_t), "moov", 4)) {
+        patch_chunk_offsets(box + kSize_BoxHeader, box_size - kSize_BoxHeader);
+      }
+      location += box_size;
+    }
+    release(size);
+  }
+};
+
 class MP4Creator {
   struct Track {
     uint32_t timescale;
@@ -76,7 +298,6 @@ class MP4Creator {
   }
 
   static const uint32_t kSize_Buffer = 4 * 1024 * 1024;
-  static const uint32_t kSize_Default = 512 * 1024;
   lsmash_adhoc_remux_t moov_to_front = { kSize_Buffer, nullptr, nullptr };
   unique_ptr<lsmash_root_t, function<void(lsmash_root_t*)>> root = { nullptr, [&](lsmash_root_t* p) {
     apply_on_tracks([&](SampleType type) {
@@ -90,14 +311,19 @@ class MP4Creator {
   unique_ptr<lsmash_video_summary_t, function<void(lsmash_video_summary_t* p)>> video_summary = { nullptr, [](lsmash_video_summary_t* p) {
     lsmash_cleanup_summary((lsmash_summary_t*)p);
   }};
-  unique_ptr<common::Data32> main_segment = nullptr;
-  unique_ptr<common::Data32> dash_data_segment = nullptr;
+  unique_ptr<common::Rope> main_segment = nullptr;
+  unique_ptr<common::Rope> dash_data_segment = nullptr;
+  uint64_t dash_data_offset = 0;  // bytes of the dash data segment already handed over, dash_data_segment holds what follows
+  int main_file_descriptor = -1;  // when valid, main segment is written to the file descriptor instead of main_segment
+  unique_ptr<MP4Stream> main_stream;  // when set, main segment is handed over to a writer as it is written instead of main_segment
+  bool faststart = true;
   uint32_t movie_timescale;
   functional::Caption<encode::Sample> caption;
   vector<util::PtsIndexPair> caption_pts_index_pairs;
   bool initialized = false;
   bool enforce_strict_dts_ordering = false;
   bool is_dash = false;
+  bool live_fragments = false;
   bool qt_compatible = false;
   struct CachedSample {
     lsmash_sample_t* ptr;
@@ -105,57 +331,70 @@ class MP4Creator {
   };
   queue<CachedSample> cached_samples;  // caching is used only when enable_strict_dts_ordering is true, otherwise l-smash handles everything
 
-  static int Write(unique_ptr<common::Data32>& data, uint8_t* buf, int size) {
+  static int Write(unique_ptr<common::Rope>& data, uint8_t* buf, int size) {
     if (size > security::kMaxWriteSize) {
       return 0;
     }
-    const uint32_t needed_size = data ? data->a() + size : size;
-    const uint32_t current_capacity = data ? data->capacity() : 0;
-    if (needed_size > current_capacity) {
-      THROW_IF(current_capacity >= std::numeric_limits<uint32_t>::max() / 2, Unsafe);
-      const uint32_t new_capacity = common::align_divide(std::max<uint32_t>(needed_size, current_capacity * 1.6), kSize_Default);
-      common::Data32* new_data = new common::Data32(new uint8_t[new_capacity], new_capacity, [](uint8_t* p) { delete[] p; });
-      THROW_IF(!new_data->data(), OutOfMemory);
-      if (data) {
-        new_data->set_bounds(data->a(), data->b());
-        memcpy((uint8_t*)new_data->data(), data->data(), data->b());
-      } else {
-        new_data->set_bounds(0, 0);
-      }
-      data.reset(new_data);
+    if (!data) {
+      data.reset(new common::Rope());
     }
-    memcpy((uint8_t*)data->data() + data->a(), buf, size);
-    data->set_bounds(data->a() + (uint32_t)size, std::max(data->b(), data->a() + (uint32_t)size));
+    data->write(buf, (uint32_t)size);
     return (int)size;
   };
 
-  static int Read(common::Data32* data, uint8_t* buf, int size) {
-    if (data->a() >= data->b()) {
-      return 0;
-    }
-    const uint32_t read_size = std::min((uint32_t)size, data->b() - data->a());
-    if (read_size) {
-      memcpy(buf, (uint8_t*)data->data() + data->a(), read_size);
-      data->set_bounds(data->a() + read_size, data->b());
-    }
-    return (int)read_size;
+  static int Read(common::Rope* data, uint8_t* buf, int size) {
+    return (int)data->read(buf, (uint32_t)size);
   };
 
-  static int64_t Seek(common::Data32* data, int64_t offset, int whence) {
+  static int64_t Seek(common::Rope* data, int64_t offset, int whence) {
     if (whence == SEEK_SET) {
-      THROW_IF(offset < 0 || offset > data->b(), OutOfRange);
-      data->set_bounds((uint32_t)offset, data->b());
+      THROW_IF(offset < 0 || (uint64_t)offset > data->size(), OutOfRange);
+      data->seek((uint64_t)offset);
       return (int64_t)offset;
     }
     return 0;
   };
 
+  static int Write(int fd, uint8_t* buf, int size) {
+    if (size > security::kMaxWriteSize) {
+      return 0;
+    }
+    int written = 0;
+    while (written < size) {
+      ssize_t result = write(fd, buf + written, size - written);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      THROW_IF(result <= 0, Invalid, "Failed writing to file descriptor");
+      written += (int)result;
+    }
+    return written;
+  };
+
+  static int Read(int fd, uint8_t* buf, int size) {
+    ssize_t result;
+    do {
+      result = read(fd, buf, size);
+    } while (result < 0 && errno == EINTR);
+    THROW_IF(result < 0, ReaderError);
+    return (int)result;
+  };
+
+  static int64_t Seek(int fd, int64_t offset, int whence) {
+    off_t result = lseek(fd, (off_t)offset, whence);
+    THROW_IF(result < 0, OutOfRange);
+    return (int64_t)result;
+  };
+
   void flush_cached_samples(bool force) {
     // manual sample caching is used only when enforce_strict_dts_ordering is true, otherwise l-smash handles everything
     THROW_IF(!enforce_strict_dts_ordering, Invalid);
 
     auto write_sample = [&](CachedSample sample, int64_t dts_offset) {
       THROW_IF(dts_offset > std::numeric_limits<uint32_t>::max(), Overflow);
+      if (main_stream) {  // every sample is flushed as its own chunk
+        main_stream->add_chunk(sample.ptr->length);
+      }
       CHECK(lsmash_append_sample(root.get(), tracks(sample.type).track_ID, sample.ptr) == 0);
       CHECK(lsmash_flush_pooled_samples(root.get(), tracks(sample.type).track_ID, (uint32_t)dts_offset) == 0);
     };
@@ -318,12 +557,7 @@ class MP4Creator {
       finalize_tracks();
     }
 
-    CHECK(lsmash_finish_movie(root.get(), &moov_to_front) == 0);  // Remux moov to beginning to cover progressive download case
-
-    if (file_format == DashData) {
-      dash_data_segment->set_bounds(0, dash_data_segment->b());
-    }
-    main_segment->set_bounds(0, main_segment->b());
+    CHECK(lsmash_finish_movie(root.get(), faststart ? &moov_to_front : nullptr) == 0);  // Remux moov to beginning to cover progressive download case
   }
 
   void setup_video_track(const settings::Video& video_settings) {
@@ -493,14 +727,34 @@ class MP4Creator {
     // Open root
     auto write_func = [](void* opaque, uint8_t* buf, int size) -> int {
       MP4Creator* creator = (MP4Creator*)opaque;
+      if (creator->main_stream) {
+        if (size > security::kMaxWriteSize) {
+          return 0;
+        }
+        creator->main_stream->write(buf, (uint32_t)size);
+        return size;
+      }
+      if (creator->main_file_descriptor >= 0) {
+        return creator->Write(creator->main_file_descriptor, buf, size);
+      }
       return creator->Write(creator->main_segment, buf, size);
     };
     auto read_func = [](void* opaque, uint8_t* buf, int size) -> int {
       MP4Creator* creator = (MP4Creator*)opaque;
+      THROW_IF(creator->main_stream, Unsupported, "Movie cannot be read back while streaming");
+      if (creator->main_file_descriptor >= 0) {
+        return creator->Read(creator->main_file_descriptor, buf, size);
+      }
       return creator->Read(creator->main_segment.get(), buf, size);
     };
     auto seek_func = [](void* opaque, int64_t offset, int whence) -> int64_t {
       MP4Creator* creator = (MP4Creator*)opaque;
+      if (creator->main_stream) {
+        return creator->main_stream->seek(offset, whence);
+      }
+      if (creator->main_file_descriptor >= 0) {
+        return creator->Seek(creator->main_file_descriptor, offset, whence);
+      }
       return creator->Seek(creator->main_segment.get(), offset, whence);
     };
     root.reset(lsmash_create_root());
@@ -575,13 +829,20 @@ class MP4Creator {
     };
     auto seek_func = [](void* opaque, int64_t offset, int whence) -> int64_t {
       MP4Creator* creator = (MP4Creator*)opaque;
+      if (whence == SEEK_SET) {
+        THROW_IF(offset < (int64_t)creator->dash_data_offset, Unsupported, "Fragments already handed over cannot be rewritten");
+        return (int64_t)creator->dash_data_offset + creator->Seek(creator->dash_data_segment.get(), offset - (int64_t)creator->dash_data_offset, whence);
+      }
       return creator->Seek(creator->dash_data_segment.get(), offset, whence);
     };
 
     dash_data_param.reset(new lsmash_file_parameters_t());
     memset((void*)dash_data_param.get(), 0, sizeof(lsmash_file_parameters_t));
 
-    *((int*)&dash_data_param->mode) = LSMASH_FILE_MODE_WRITE | LSMASH_FILE_MODE_FRAGMENTED | LSMASH_FILE_MODE_BOX | LSMASH_FILE_MODE_MEDIA | LSMASH_FILE_MODE_INDEX | LSMASH_FILE_MODE_SEGMENT;
+    *((int*)&dash_data_param->mode) = LSMASH_FILE_MODE_WRITE | LSMASH_FILE_MODE_FRAGMENTED | LSMASH_FILE_MODE_BOX | LSMASH_FILE_MODE_MEDIA | LSMASH_FILE_MODE_SEGMENT;
+    if (!live_fragments) {  // sidx is written once the segment is complete, live fragments are handed over before that
+      *((int*)&dash_data_param->mode) |= LSMASH_FILE_MODE_INDEX;
+    }
     dash_data_param->opaque = (void*)this;
     dash_data_param->read = read_func;
     dash_data_param->write = write_func;
@@ -619,7 +880,7 @@ class MP4Creator {
     initialized = true;
   }
 
-  common::Data32* file() {
+  common::Rope* file() {
     if (file_format == DashData) {
       CHECK(dash_data_segment.get());
       return dash_data_segment.release();
@@ -629,7 +890,7 @@ class MP4Creator {
     }
   }
 public:
-  common::Data32* create(const functional::Audio<encode::Sample>& audio, const functional::Video<encode::Sample>& video, const functional::Caption<encode::Sample>& caption, const vector<common::EditBox> edit_boxes, const FileFormat file_format) {
+  common::Rope* create(const functional::Audio<encode::Sample>& audio, const functional::Video<encode::Sample>& video, const functional::Caption<encode::Sample>& caption, const vector<common::EditBox> edit_boxes, const FileFormat file_format) {
     if (file_format != DashInitializer) {
       THROW_IF(!audio.count() && !video.count(), InvalidArguments);
     }
@@ -638,55 +899,137 @@ public:
     mux(audio, video, caption, edit_boxes);
     return file();
   }
+
+  // Writes the movie into file_descriptor as samples are muxed, file_descriptor has to be seekable and opened for reading and writing.
+  // With faststart, moov is moved to the front in place within the file using a bounded buffer.
+  void create(const functional::Audio<encode::Sample>& audio, const functional::Video<encode::Sample>& video, const functional::Caption<encode::Sample>& caption, const vector<common::EditBox> edit_boxes, int file_descriptor, bool faststart) {
+    THROW_IF(!audio.count() && !video.count(), InvalidArguments);
+    THROW_IF(file_descriptor < 0, InvalidArguments);
+    THROW_IF(lseek(file_descriptor, 0, SEEK_SET) != 0, InvalidArguments, "File descriptor has to be seekable");
+    THROW_IF(ftruncate(file_descriptor, 0) != 0, InvalidArguments, "File descriptor has to be a writable file");
+    main_file_descriptor = file_descriptor;
+    this->faststart = faststart;
+
+    init(audio.settings(), video.settings(), FileFormat::Regular);
+    mux(audio, video, caption, edit_boxes);
+  }
+
+  // Hands the movie over to writer as samples are muxed, with moov at the end. Every sample is flushed as its own chunk
+  // so that mdat can be split on sample boundaries, and at most about kSize_Buffer bytes of samples are held at a time.
+  void create(const functional::Audio<encode::Sample>& audio, const functional::Video<encode::Sample>& video, const functional::Caption<encode::Sample>& caption, const vector<common::EditBox> edit_boxes, const std::function<void(const common::Data32& data)>& writer) {
+    THROW_IF(!audio.count() && !video.count(), InvalidArguments);
+    main_stream.reset(new MP4Stream(writer, kSize_Buffer));
+    faststart = false;
+    enforce_strict_dts_ordering = true;
+
+    init(audio.settings(), video.settings(), FileFormat::Regular);
+    mux(audio, video, caption, edit_boxes);
+    main_stream->finish();
+  }
+
+  // Live fragmenting: a single media segment (styp once, no sidx) that fragments are added to one at a time,
+  // so that sequence numbers and decode times carry on across fragments
+  void start_fragments(const settings::Audio& audio_settings, const settings::Video& video_settings) {
+    live_fragments = true;
+    init(audio_settings, video_settings, FileFormat::DashData);
+  }
+
+  // Muxes samples into the open fragment, in dts order across tracks. last_durations are the durations of the last sample of each track,
+  // 0 to repeat the previous dts offset. Unless last, the fragment is written and the next one opened.
+  void add_fragment(const vector<encode::Sample>& audio, const vector<encode::Sample>& video, const uint32_t last_durations[kNumTracks], bool last) {
+    THROW_IF(!live_fragments, Invalid);
+    const uint32_t audio_timescale = tracks(SampleType::Audio).timescale;
+    const uint32_t video_timescale = tracks(SampleType::Video).timescale;
+    auto audio_sample = audio.begin();
+    for (const auto& video_sample: video) {
+      while (audio_sample != audio.end() && audio_sample->dts * (int64_t)video_timescale < video_sample.dts * (int64_t)audio_timescale) {
+        mux(*audio_sample++);
+      }
+      mux(video_sample);
+    }
+    while (audio_sample != audio.end()) {
+      mux(*audio_sample++);
+    }
+    for (auto type: enumeration::Enum<SampleType>(SampleType::Video, SampleType::Audio)) {
+      if ((type == SampleType::Video ? video : audio).empty()) {
+        continue;
+      }
+      const uint32_t i = type - SampleType::Video;
+      const int64_t last_duration = last_durations[i] ? last_durations[i] : (tracks(type).last_dts_offset ? tracks(type).last_dts_offset : 1);
+      THROW_IF(last_duration > std::numeric_limits<uint32_t>::max(), Overflow);
+      CHECK(lsmash_flush_pooled_samples(root.get(), tracks(type).track_ID, (uint32_t)last_duration) == 0);
+    }
+    if (last) {
+      CHECK(lsmash_finish_movie(root.get(), nullptr) == 0);
+    } else {
+      CHECK(lsmash_create_fragment_movie(root.get()) == 0);
+    }
+  }
+
+  // Bytes written since the last call, the dash data segment only keeps what was not handed over yet
+  common::Data32 take_fragments() {
+    if (!dash_data_segment || !dash_data_segment->size()) {
+      return common::Data32();
+    }
+    CHECK(dash_data_segment->position() == dash_data_segment->size());
+    auto fragments = dash_data_segment->data();
+    dash_data_offset += dash_data_segment->size();
+    dash_data_segment.reset();
+    return fragments;
+  }
 };
 
-struct MP4BoxHandler {
-  static uint32_t LocateBox(const common::Data32* file, const char box_name[]) {
+struct MP4BoxHandler {  // box headers are copied out of the file one at a time, the file itself is never flattened
+  static uint64_t LocateBox(const common::Rope& file, const char box_name[]) {
     size_t box_name_length = strlen(box_name);
     THROW_IF(box_name_length <= 0, InvalidArguments);
-    THROW_IF(!file, InvalidArguments);
-    THROW_IF(file->count() < sizeof(uint32_t) + box_name_length, InvalidArguments);
+    THROW_IF(file.size() < sizeof(uint32_t) + box_name_length, InvalidArguments);
     int64_t box_location = -1;
-    auto data = common::Data32(file->data() + file->a(), file->count(), nullptr);
-    while (data.count()) {
-      for (uint32_t j = 0; j < box_name_length; ++j) {
-        if (data(data.a() + sizeof(uint32_t) + j) != box_name[j]) {
+    uint64_t location = 0;
+    while (location < file.size()) {
+      if (file.size() - location >= sizeof(uint32_t) + box_name_length) {
+        const auto header = file.data(location, sizeof(uint32_t) + (uint32_t)box_name_length);
+        if (memcmp(header.data() + sizeof(uint32_t), box_name, box_name_length) == 0) {
+          box_location = (int64_t)location;
           break;
-        } else if (j == box_name_length - 1) {
-          box_location = data.a();
         }
       }
-      if (box_location < 0) {
-        uint32_t box_size = BoxSize(data);
-        THROW_IF(box_size == 0, Invalid);
-        data.set_bounds(data.a() + box_size, data.b());
-      } else {
-        break;
-      }
+      uint64_t box_size = BoxSize(file, location);
+      THROW_IF(box_size == 0, Invalid);
+      THROW_IF(box_size > file.size() - location, Invalid);
+      location += box_size;
     }
     THROW_IF(box_location < 0, Invalid);
-    return (uint32_t)box_location;
+    return (uint64_t)box_location;
   }
 
-  static uint32_t BoxSize(const common::Data32& box) {
-    THROW_IF(box.count() < sizeof(uint32_t), InvalidArguments);  // each box starts with a 32-bit size field
-    const uint8_t* buffer = box.data() + box.a();
-    const uint32_t box_size = (buffer[0] << 24) + (buffer[1] << 16) + (buffer[2] << 8) + buffer[3];
-    THROW_IF(box_size == 1, Unsupported);  // extended size field present to support files larger than 2^32 bytes
-    if (box_size == 0) {  // implicit
-      return box.count();
+  static uint64_t Field(const common::Rope& file, uint64_t location, uint32_t size) {  // big endian
+    THROW_IF(location > file.size() || file.size() - location < size, InvalidArguments);
+    const auto field = file.data(location, size);
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      value = (value << 8) | field.data()[i];
+    }
+    return value;
+  }
+
+  static uint64_t BoxSize(const common::Rope& file, uint64_t location) {
+    const uint64_t box_size = Field(file, location, sizeof(uint32_t));  // each box starts with a 32-bit size field
+    if (box_size == 1) {  // extended size field after the box type, l-smash writes one for mdat past 4GB
+      return Field(file, location + 2 * sizeof(uint32_t), sizeof(uint64_t));
+    } else if (box_size == 0) {  // implicit
+      return file.size() - location;
     } else {
       return box_size;
     }
   }
 
-  static uint32_t HeaderSize(const common::Data32* file) {  // assumes [header | samples] format
-    THROW_IF(!file, Invalid);
+  static uint64_t HeaderSize(const common::Rope& file) {  // assumes [header | samples] format
     const char box_name[] = "mdat";
-    const uint32_t location = LocateBox(file, box_name);
-    const auto mdat = common::Data32(file->data() + file->a() + location, file->count() - location, nullptr);
-    THROW_IF(BoxSize(mdat) != mdat.count(), Invalid);  // mdat has to span till the end of file
-    return location + sizeof(uint32_t) + (uint32_t)strlen(box_name);  // mdat box size and "mdat" belongs to header
+    const uint64_t location = LocateBox(file, box_name);
+    THROW_IF(BoxSize(file, location) != file.size() - location, Invalid);  // mdat has to span till the end of file
+    const bool extended = Field(file, location, sizeof(uint32_t)) == 1;
+    return location + sizeof(uint32_t) + strlen(box_name) + (extended ? sizeof(uint64_t) : 0);  // mdat box size and "mdat" belongs to header
   }
 };
 
@@ -696,14 +1039,14 @@ struct _MP4 {
   functional::Caption<encode::Sample> caption;
   vector<common::EditBox> edit_boxes;
   FileFormat file_format;
-  unique_ptr<common::Data32> cached_file;
+  unique_ptr<common::Rope> cached_file;
+  uint64_t cached_offset = 0;  // range of cached_file that makes up file_format
+  uint64_t cached_size = 0;
   void create_and_cache_file() {
     MP4Creator creator;
     cached_file.reset(creator.create(audio, video, caption, edit_boxes, file_format));
-    if (file_format == FileFormat::SamplesOnly) {
-      uint32_t header_size = MP4BoxHandler::HeaderSize(cached_file.get());
-      cached_file->set_bounds(header_size, cached_file->b());
-    }
+    cached_offset = file_format == FileFormat::SamplesOnly ? MP4BoxHandler::HeaderSize(*cached_file) : 0;
+    cached_size = cached_file->size() - cached_offset;
   }
 };
 
@@ -726,7 +1069,8 @@ MP4::MP4(const functional::Audio<encode::Sample>& audio, const functional::Video
     if (!_this->cached_file) {
       _this->create_and_cache_file();
     }
-    return *_this->cached_file.get();
+    THROW_IF(_this->cached_size > numeric_limits<uint32_t>::max(), Unsafe, "file does not fit in a single buffer, use blocks()");
+    return _this->cached_file->data(_this->cached_offset, (uint32_t)_this->cached_size);
   };
 }
 
@@ -748,12 +1092,176 @@ auto MP4::operator()() -> common::Data32 {
   // 4- move(...)                           : prevents copying the common::Data32
 }
 
+auto MP4::operator()(int file_descriptor, bool faststart) -> void {
+  THROW_IF(_this->file_format != FileFormat::Regular, Unsupported);
+  MP4Creator creator;
+  creator.create(_this->audio, _this->video, _this->caption, _this->edit_boxes, file_descriptor, faststart);
+}
+
+auto MP4::operator()(const std::function<void(const common::Data32& data)>& writer, bool faststart) -> void {
+  THROW_IF(!writer, InvalidArguments);
+  THROW_IF(_this->file_format != FileFormat::Regular, Unsupported);
+  if (!faststart) {
+    MP4Creator creator;
+    creator.create(_this->audio, _this->video, _this->caption, _this->edit_boxes, writer);
+    return;
+  }
+  // l-smash has to seek back into the output, so stage it in an unlinked temporary file rather than in memory
+  unique_ptr<FILE, function<void(FILE*)>> staging_file = { tmpfile(), [](FILE* p) { fclose(p); } };
+  THROW_IF(!staging_file, OutOfMemory, "Failed creating temporary file");
+  const int fd = fileno(staging_file.get());
+  (*this)(fd, faststart);
+
+  const uint32_t kSize_Buffer = 4 * 1024 * 1024;
+  common::Data32 buffer((uint8_t*)malloc(kSize_Buffer), kSize_Buffer, [](uint8_t* p) { free(p); });
+  THROW_IF(!buffer.data(), OutOfMemory);
+  CHECK(lseek(fd, 0, SEEK_SET) == 0);
+  while (true) {
+    ssize_t read_size = read(fd, (void*)buffer.data(), kSize_Buffer);
+    if (read_size < 0 && errno == EINTR) {
+      continue;
+    }
+    THROW_IF(read_size < 0, ReaderError);
+    if (read_size == 0) {
+      break;
+    }
+    buffer.set_bounds(0, (uint32_t)read_size);
+    writer(buffer);
+  }
+}
+
+struct _Fragmenter {
+  settings::Audio audio_settings;
+  settings::Video video_settings;
+  uint64_t fragment_duration_ms;
+  std::deque<encode::Sample> audio_samples;  // received but not muxed yet, in dts order
+  std::deque<encode::Sample> video_samples;
+  std::deque<int64_t> cuts;  // dts of the lead track samples starting the fragments to mux next
+  int64_t fragment_start_dts = 0;
+  bool started = false;
+  bool finished = false;
+  MP4Creator creator;  // one media segment for all fragments
+  _Fragmenter(const settings::Audio& audio_settings, const settings::Video& video_settings, uint64_t fragment_duration_ms)
+    : audio_settings(audio_settings), video_settings(video_settings), fragment_duration_ms(fragment_duration_ms) {}
+  auto lead_type() const -> SampleType {
+    return video_settings.timescale ? SampleType::Video : SampleType::Audio;
+  }
+  auto timescale(SampleType type) const -> uint32_t {
+    return type == SampleType::Video ? video_settings.timescale : audio_settings.timescale;
+  }
+  auto samples(SampleType type) -> std::deque<encode::Sample>& {
+    return type == SampleType::Video ? video_samples : audio_samples;
+  }
+  auto before(const encode::Sample& sample, int64_t lead_dts) const -> bool {
+    return sample.dts * (int64_t)timescale(lead_type()) < lead_dts * (int64_t)timescale(sample.type);
+  }
+  auto take(SampleType type, int64_t cut, bool all) -> vector<encode::Sample> {
+    auto& queue = samples(type);
+    vector<encode::Sample> taken;
+    while (!queue.empty() && (all || before(queue.front(), cut))) {
+      taken.push_back(queue.front());
+      queue.pop_front();
+    }
+    return taken;
+  }
+  auto mux_fragment(int64_t cut, bool last) -> void {
+    auto audio = take(SampleType::Audio, cut, last);
+    auto video = take(SampleType::Video, cut, last);
+    uint32_t last_durations[kNumTracks] = { 0, 0 };  // exact when the sample following the fragment is already there
+    if (!video.empty() && !video_samples.empty()) {
+      last_durations[SampleType::Video - SampleType::Video] = (uint32_t)(video_samples.front().dts - video.back().dts);
+    }
+    if (!audio.empty() && !audio_samples.empty()) {
+      last_durations[SampleType::Audio - SampleType::Video] = (uint32_t)(audio_samples.front().dts - audio.back().dts);
+    }
+    creator.add_fragment(audio, video, last_durations, last);
+  }
+  auto mux_fragments(bool force) -> void {
+    // a fragment ends on a lead track keyframe and takes every sample before it in dts order, which is only known
+    // once the other track has received a sample past that point
+    const SampleType other_type = lead_type() == SampleType::Video ? SampleType::Audio : SampleType::Video;
+    const bool other_track = timescale(other_type) != 0;
+    while (!cuts.empty()) {
+      const int64_t cut = cuts.front();
+      auto& other_samples = samples(other_type);
+      if (!force && other_track && (other_samples.empty() || before(other_samples.back(), cut))) {
+        break;
+      }
+      mux_fragment(cut, false);
+      cuts.pop_front();
+    }
+  }
+};
+
+MP4::Fragmenter::Fragmenter(const settings::Audio& audio_settings, const settings::Video& video_settings, uint64_t fragment_duration_ms)
+  : _this(make_shared<_Fragmenter>(audio_settings, video_settings, fragment_duration_ms)) {
+  THROW_IF(video_settings.timescale == 0 && audio_settings.sample_rate == 0, InvalidArguments);
+  THROW_IF(fragment_duration_ms == 0, InvalidArguments);
+  THROW_IF(video_settings.sps_pps.sps.count() >= security::kMaxHeaderSize, Unsafe);
+  THROW_IF(video_settings.sps_pps.pps.count() >= security::kMaxHeaderSize, Unsafe);
+  if (video_settings.timescale) {
+    THROW_IF(!security::valid_dimensions(video_settings.width, video_settings.height), Unsafe);
+  }
+  THROW_IF(settings::Audio::IsPCM(audio_settings.codec), Unsupported);
+  _this->creator.start_fragments(audio_settings, video_settings);
+}
+
+MP4::Fragmenter::Fragmenter(const Fragmenter& fragmenter)
+  : _this(fragmenter._this) {}
+
+auto MP4::Fragmenter::initializer() const -> common::Data32 {
+  MP4Creator creator;
+  unique_ptr<common::Rope> initializer(creator.create(functional::Audio<encode::Sample>(vector<encode::Sample>(), _this->audio_settings),
+                                                        functional::Video<encode::Sample>(vector<encode::Sample>(), _this->video_settings),
+                                                        functional::Caption<encode::Sample>(),
+                                                        vector<common::EditBox>(),
+                                                        FileFormat::DashInitializer));
+  return initializer->data();
+}
+
+auto MP4::Fragmenter::operator()(const encode::Sample& sample) -> common::Data32 {
+  THROW_IF(_this->finished, Invalid);
+  THROW_IF(sample.type != SampleType::Audio && sample.type != SampleType::Video, InvalidArguments);
+  THROW_IF(sample.type == SampleType::Video && !_this->video_settings.timescale, InvalidArguments);
+  THROW_IF(sample.type == SampleType::Audio && !_this->audio_settings.sample_rate, InvalidArguments);
+  THROW_IF(_this->audio_samples.size() >= security::kMaxSampleCount, Unsafe);
+  THROW_IF(_this->video_samples.size() >= security::kMaxSampleCount, Unsafe);
+  auto& samples = _this->samples(sample.type);
+  THROW_IF(!samples.empty() && sample.dts <= samples.back().dts, Invalid);
+
+  if (sample.type == _this->lead_type()) {
+    if (!_this->started) {
+      THROW_IF(sample.type == SampleType::Video && !sample.keyframe, Invalid, "Fragment has to start with a keyframe");
+      _this->started = true;
+      _this->fragment_start_dts = sample.dts;
+    } else if (sample.keyframe) {
+      THROW_IF(sample.dts < _this->fragment_start_dts, Invalid);
+      if ((uint64_t)(sample.dts - _this->fragment_start_dts) * kMilliSecondScale >= _this->fragment_duration_ms * _this->timescale(sample.type)) {
+        _this->cuts.push_back(sample.dts);
+        _this->fragment_start_dts = sample.dts;
+      }
+    }
+  }
+  samples.push_back(sample);
+  _this->mux_fragments(false);
+  return _this->creator.take_fragments();
+}
+
+auto MP4::Fragmenter::flush() -> common::Data32 {
+  THROW_IF(_this->finished, Invalid);
+  _this->finished = true;
+  _this->mux_fragments(true);
+  if (!_this->audio_samples.empty() || !_this->video_samples.empty()) {
+    _this->mux_fragment(0, true);
+  }  // otherwise the fragment opened after the last one is left empty and never written
+  return _this->creator.take_fragments();
+}
+
 auto MP4::operator()(FileFormat file_format) -> common::Data32 {
   if (file_format != _this->file_format) {
     if (file_format == FileFormat::HeaderOnly && _this->file_format == FileFormat::SamplesOnly && _this->cached_file) {  // special case where we can avoid reprocessing
-      _this->cached_file->set_bounds(0, _this->cached_file->b());
-      uint32_t header_size = MP4BoxHandler::HeaderSize(_this->cached_file.get());
-      _this->cached_file->set_bounds(_this->cached_file->a(), _this->cached_file->a() + header_size);
+      _this->cached_offset = 0;
+      _this->cached_size = MP4BoxHandler::HeaderSize(*_this->cached_file);
     } else {
       _this->file_format = file_format;
       _this->cached_file.reset(nullptr);
@@ -762,4 +1270,11 @@ auto MP4::operator()(FileFormat file_format) -> common::Data32 {
   return move((*static_cast<std::function<common::Data32(void)>*>(this))());
 }
 
+auto MP4::blocks() -> vector<common::Data32> {
+  if (!_this->cached_file) {
+    _this->create_and_cache_file();
+  }
+  return _this->cached_file->blocks(_this->cached_offset, _this->cached_size);
+}
+
 }}
@@ -50,6 +50,28 @@ public:
   DISALLOW_ASSIGN(MP4);
   auto operator()() -> common::Data32;
   auto operator()(FileFormat file_format) -> common::Data32;
+  auto blocks() -> vector<common::Data32>;  // same contents as operator()(), as views into the muxer's buffer (e.g. for writev) that keep it alive, also across a switch of file format
+  // Streaming output: mdat is written incrementally instead of building the whole movie in memory (FileFormat::Regular only)
+  // file_descriptor has to be seekable and opened for both reading and writing
+  auto operator()(int file_descriptor, bool faststart = true) -> void;
+  // Streaming output to a writer (FileFormat::Regular only): the movie is handed over as it is muxed with moov at the end,
+  // samples split across several mdat boxes. With faststart, it is staged in a temporary file to move moov to the front first
+  auto operator()(const std::function<void(const common::Data32& data)>& writer, bool faststart = false) -> void;
+
+  // Live fragmenting: samples are pushed as they come out of the encoders and fragments (moof / mdat) are cut
+  // on keyframes of the video track (or of the audio track when there is no video) once they span fragment_duration_ms.
+  // Fragments make up a single media segment: styp comes with the first one, sequence numbers carry on and each fragment
+  // takes the samples of the other track by dts, so it is completed once that track has received a sample past its end
+  class PUBLIC Fragmenter final {
+    std::shared_ptr<struct _Fragmenter> _this = nullptr;
+  public:
+    Fragmenter(const settings::Audio& audio_settings, const settings::Video& video_settings, uint64_t fragment_duration_ms);
+    Fragmenter(const Fragmenter& fragmenter);
+    DISALLOW_ASSIGN(Fragmenter);
+    auto initializer() const -> common::Data32;  // same as FileFormat::DashInitializer
+    auto operator()(const encode::Sample& sample) -> common::Data32;  // fragments completed by sample, empty if there are none
+    auto flush() -> common::Data32;  // remaining fragments and samples, ends the segment
+  };
 };
 
 }}
@@ -27,6 +27,7 @@
 #include "vireo/base_cpp.h"
 #include "vireo/common/enum.hpp"
 #include "vireo/common/math.h"
+#include "vireo/common/rope.h"
 #include "vireo/common/security.h"
 #include "vireo/constants.h"
 #include "vireo/encode/util.h"
@@ -40,16 +41,15 @@ namespace mux {
 
 struct _WebM {
   struct Writer : public mkvmuxer::MkvWriter {
-    static const size_t kSize_Default = 512 * 1024;
-    unique_ptr<common::Data32> movie = NULL;
+    unique_ptr<common::Rope> movie = NULL;  // grows block by block, seeking back to patch sizes and cues never moves what is written
     mkvmuxer::int64 Position() const {
-      return movie.get() ? movie->a() : 0;
+      return movie.get() ? movie->position() : 0;
     }
     mkvmuxer::int32 Position(mkvmuxer::int64 position) {
-      if (!movie.get() || position < 0 || position > movie->b()) {
+      if (!movie.get() || position < 0 || (uint64_t)position > movie->size()) {
         return 1;
       }
-      movie->set_bounds((uint32_t)position, movie->b());
+      movie->seek((uint64_t)position);
       return 0;
     }
     bool Seekable() const {
@@ -59,20 +59,10 @@ struct _WebM {
       if (length > security::kMaxWriteSize) {
         return 1;
       }
-      if (!movie || length + movie->a() > movie->capacity()) {
-        const uint32_t new_capacity = movie ? movie->capacity() + common::align_divide(length + movie->a() - movie->capacity(), (uint32_t)kSize_Default) : common::align_divide(length, (uint32_t)kSize_Default);
-        common::Data32* new_data = new common::Data32(new uint8_t[new_capacity], new_capacity, [](uint8_t* p) { delete[] p; });
-        THROW_IF(!new_data->data(), OutOfMemory);
-        if (movie) {
-          new_data->set_bounds(movie->a(), movie->b());
-          memcpy((uint8_t*)new_data->data(), movie->data(), movie->b());
-        } else {
-          new_data->set_bounds(0, 0);
-        }
-        movie.reset(new_data);
+      if (!movie) {
+        movie.reset(new common::Rope());
       }
-      memcpy((uint8_t*)movie->data() + movie->a(), buffer, length);
-      movie->set_bounds(movie->a() + length, std::max((uint32_t)movie->b(), (uint32_t)(movie->a() + length)));
+      movie->write((const uint8_t*)buffer, length);
       return 0;
     }
     void ElementStartNotify(mkvmuxer::uint64 element_id, mkvmuxer::int64 position) {}
@@ -127,7 +117,6 @@ struct _WebM {
 
       CHECK(muxer_segment.Finalize());
       writer.Close();
-      writer.movie->set_bounds(0, writer.movie->b());
       finalized = true;
     }
   }
@@ -191,7 +180,7 @@ WebM::WebM(const functional::Audio<encode::Sample>& audio, const functional::Vid
     THROW_IF(!_this->initialized, Uninitialized);
     _this->flush();
     CHECK(_this->writer.movie.get());
-    return *_this->writer.movie.get();
+    return _this->writer.movie->data();
   };
 }
 
@@ -204,4 +193,11 @@ WebM::WebM(WebM&& webm)
   webm._this = NULL;
 }
 
+auto WebM::blocks() -> vector<common::Data32> {
+  THROW_IF(!_this->initialized, Uninitialized);
+  _this->flush();
+  CHECK(_this->writer.movie.get());
+  return _this->writer.movie->blocks();
+}
+
 }}
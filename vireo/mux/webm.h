@@ -40,6 +40,7 @@ public:
   WebM(const WebM& webm);
   WebM(WebM&& webm);
   DISALLOW_ASSIGN(WebM);
+  auto blocks() -> vector<common::Data32>;  // same contents as operator()(), as views into the muxer's buffer (e.g. for writev) that keep it alive
 };
 
 }}
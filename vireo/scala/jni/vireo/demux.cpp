@@ -97,7 +97,7 @@ static void _InitMovieWithReader(JNIEnv* env, jobject movie_obj, jobject reader_
   const int32_t size = jni->reader->jni_reader.call<jint>("size", "()I");
   CHECK(size >= 0);
   _JNIReader* reader = jni->reader.get();
-  auto read_func = [reader](const uint32_t offset, const uint32_t size) -> common::Data32 {
+  auto read_func = [reader](const uint64_t offset, const uint32_t size) -> common::Data32 {
     CHECK(reader);
     JNIEnv* env = reader->env;
     THROW_IF(offset > numeric_limits<int32_t>::max(), Overflow);
@@ -106,7 +106,7 @@ static void _InitMovieWithReader(JNIEnv* env, jobject movie_obj, jobject reader_
     THROW_IF(!byte_data_obj, ReaderError);
     return jni::createData<common::Data32>(env, byte_data_obj, reader->jni_reader, false);
   };
-  jni->movie.reset(new demux::Movie(common::Reader(size, read_func)));
+  jni->movie.reset(new demux::Movie(common::Reader((uint64_t)size, read_func)));
 
   jni::Wrap jni_movie_video_track = jni::Wrap(env, jni_movie.get("videoTrack", "Lcom/twitter/vireo/demux/Movie$VideoTrack;"));
   jni_movie_video_track.set<jint>("b", jni->movie->video_track.count());
@@ -187,8 +187,9 @@ jobject JNICALL Java_com_twitter_vireo_demux_jni_Movie_decode(JNIEnv* env, jobje
     jni->nal_funcs[make_tuple((SampleType)sample_type, index)] = move(sample.nal);
     auto jni_sample = [&]() -> jni::Wrap {
       if (sample.byte_range.available) {
+        THROW_IF(sample.byte_range.pos > numeric_limits<int32_t>::max(), Overflow);  // Movie$Sample positions are Int
         return jni::Wrap(env, "com/twitter/vireo/demux/jni/Movie$Sample", "(Lcom/twitter/vireo/demux/jni/Movie;JJZBIII)V",
-                         movie_obj, sample.pts, sample.dts, sample.keyframe, sample.type, sample.byte_range.pos, sample.byte_range.size, index);
+                         movie_obj, sample.pts, sample.dts, sample.keyframe, sample.type, (jint)sample.byte_range.pos, sample.byte_range.size, index);
       } else {
         // jni has no way of creating Option[ByteRange], we use size < 0 to signal None
         return jni::Wrap(env, "com/twitter/vireo/demux/jni/Movie$Sample", "(Lcom/twitter/vireo/demux/jni/Movie;JJZBIII)V",
@@ -135,7 +135,7 @@ int main(int argc, const char* argv[]) {
     mux::MP4 muxer(functional::Audio<encode::Sample>(stitched.audio_track, encode::Sample::Convert),
                    functional::Video<encode::Sample>(stitched.video_track, encode::Sample::Convert),
                    edit_boxes);
-    util::save(vireo::common::Path::MakeAbsolute(argv[argc - 1]), muxer());
+    util::save(vireo::common::Path::MakeAbsolute(argv[argc - 1]), muxer.blocks());
   } __catch (std::exception& e) {
 #if __EXCEPTIONS
     cerr << "Error stitching movie: " << e.what() << endl;
@@ -30,6 +30,7 @@
 #include "vireo/base_cpp.h"
 #include "vireo/common/math.h"
 #include "vireo/common/path.h"
+#include "vireo/decode/thumbnails.h"
 #include "vireo/decode/video.h"
 #include "vireo/demux/movie.h"
 #include "vireo/encode/jpg.h"
@@ -45,24 +46,37 @@ using std::vector;
 int main(int argc, const char* argv[]) {
   if (argc < 5) {
     const string name = common::Path::Filename(argv[0]);
-    cout << "Usage: " << name << " size count input output" << endl;
+    cout << "Usage: " << name << " [options] size count input output" << endl;
+    cout << "\nOptions:" << endl;
+    cout << "--keyframes:\tfast mode, decode only the keyframes nearest to the requested frames (duplicates are dropped)" << endl;
     return 1;
   }
-  const int size = atoi(argv[1]);
+  bool keyframes = false;
+  int last_arg = 1;
+  for (int i = 1; i < argc - 4; ++i) {
+    if (strcmp(argv[i], "--keyframes") == 0) {
+      keyframes = true;
+      last_arg = i + 1;
+    } else {
+      cout << "Invalid argument: " << argv[i] << endl;
+      return 1;
+    }
+  }
+  const int size = atoi(argv[last_arg]);
   if (size < 50 || size > 1024) {
     cout << "Invalid thumnail size: " << size << " (minimum 50, maximum 1024)" << endl;
     return 1;
   }
-  const int count = atoi(argv[2]);
+  const int count = atoi(argv[last_arg + 1]);
   if (count < 2 || count > 100) {
     cout << "Invalid requested thumbnail count: " << count << " (minimum 2, maximum 100)" << endl;
     return 1;
   }
   stringstream s_src;
-  s_src << common::Path::MakeAbsolute(argv[3]);
+  s_src << common::Path::MakeAbsolute(argv[last_arg + 2]);
 
   stringstream s_dst;
-  s_dst << common::Path::MakeAbsolute(argv[4]);
+  s_dst << common::Path::MakeAbsolute(argv[last_arg + 3]);
   if (!common::Path::Exists(s_dst.str())) {
     if (common::Path::CreateFolder(s_dst.str())) {
       cout << "Error creating output folder: " << s_dst.str() << endl;
@@ -73,25 +87,35 @@ int main(int argc, const char* argv[]) {
   __try {
     // Demux file
     vireo::demux::Movie movie(s_src.str());
-    vireo::decode::Video decoder(movie.video_track);
-
-    // Get indices at which to produce thumbnails
-    set<uint32_t> indices;
-    for (uint32_t i = 0; i < count; ++i) {
-      indices.insert(common::round_divide(i * (decoder.count() - 1), (uint32_t)1, (uint32_t)count - 1));
+    functional::Video<frame::YUV> yuvs;
+    if (keyframes) {
+      // Only keyframes closest to evenly spaced positions are decoded
+      vireo::decode::Thumbnails thumbnails(movie.video_track, count, size);
+      yuvs = functional::Video<frame::YUV>(thumbnails, [](const frame::Frame& frame) -> frame::YUV { return frame.yuv().full_range(true); });
+    } else {
+      vireo::decode::Video decoder(movie.video_track);
+      // Get indices at which to produce thumbnails
+      set<uint32_t> indices;
+      for (uint32_t i = 0; i < count; ++i) {
+        indices.insert((uint32_t)common::round_divide((uint64_t)i, (uint64_t)(decoder.count() - 1), (uint64_t)count - 1));
+      }
+      yuvs = functional::Video<frame::YUV>(decoder.filter_index([&indices](uint32_t index) { return indices.find(index) != indices.end(); }), [size, width=decoder.settings().width](const frame::Frame& frame) -> frame::YUV { return frame.yuv().full_range(true).scale(size, width); });
     }
-    // Stream resized frames to jpg encoder
-    vireo::encode::JPG jpg_encoder(functional::Video<frame::YUV>(decoder.filter_index([&indices](uint32_t index) { return indices.find(index) != indices.end(); }), [size, width=decoder.settings().width](const frame::Frame& frame) -> frame::YUV { return frame.yuv().full_range(true).scale(size, width); }), 95, 0);
-    // Create thumbnails
+    // Stream thumbnails to jpg encoder
+    vireo::encode::JPG jpg_encoder(yuvs, 95, 0);
+    // Create thumbnails, encoded on all cores
     uint32_t index = 0;
     uint32_t jpg_index = 0;
-    for (auto jpg: jpg_encoder) {
+    for (const auto& jpg: jpg_encoder(0, jpg_encoder.count())) {
       stringstream jpg_dst;
       jpg_dst << s_dst.str() << "/" << jpg_index++ << ".jpg";
       ofstream ostream(common::Path::MakeAbsolute(jpg_dst.str()).c_str(), ofstream::out | ofstream::binary);
       ostream << jpg;
       ++index;
     }
+    if (index < (uint32_t)count) {
+      cerr << "Wrote " << index << " thumbnails out of " << count << " requested" << endl;
+    }
   } __catch (std::exception& e) {
     cerr << "Error reading movie" << endl;
     return 1;
@@ -22,6 +22,7 @@
  * SOFTWARE.
  */
 
+#include <fcntl.h>
 #include <iomanip>
 #include <fstream>
 #include <set>
@@ -45,6 +46,7 @@
 #include "vireo/mux/webm.h"
 #include "vireo/util/util.h"
 #include "vireo/tests/test_common.h"
+#include "vireo/transform/pipeline.h"
 #include "vireo/transform/trim.h"
 
 using std::ifstream;
@@ -482,27 +484,22 @@ functional::Video<encode::Sample> transcode(const functional::Video<decode::Samp
 
   auto crop_scale_rotate = [](frame::Frame frame, uint16_t in_width, uint16_t in_height, settings::Video::Orientation orientation, uint16_t out_width, uint16_t out_height) -> frame::Frame {
     return (frame::Frame){ frame.pts, [in_width, in_height, orientation, out_width, out_height, yuv_func = frame.yuv]() {
-      // crop - if necessary
+      // crop to the center square - if necessary
       const bool square = (out_width == out_height);
       const uint16_t min_dim = min(in_width, in_height);
       const uint16_t crop_x_offset = square ? (in_width - min_dim) / 2 : 0;
       const uint16_t crop_y_offset = square ? (in_height - min_dim) / 2 : 0;
-      auto yuv_cropped_func = (crop_x_offset == 0 && crop_y_offset == 0) ? yuv_func : [crop_x_offset, crop_y_offset, min_dim, &yuv_func](){
-        return yuv_func().crop(crop_x_offset, crop_y_offset, min_dim, min_dim);
-      };
       const uint16_t cropped_width = in_width - 2 * crop_x_offset;
       const uint16_t cropped_height = in_height - 2 * crop_y_offset;
-      // scale - if necessary
       const bool is_portrait = orientation % 2;
-      const uint16_t real_height = is_portrait ? cropped_width : cropped_height;
-      auto yuv_scaled_func = (real_height == out_height) ? yuv_cropped_func : [real_height, out_height, &yuv_cropped_func](){
-        return yuv_cropped_func().scale(out_height, real_height);
-      };
-      // rotate - if necessary
-      auto yuv_rotated_func = (orientation == settings::Video::Landscape) ? yuv_scaled_func : [orientation, &yuv_scaled_func](){
-        return yuv_scaled_func().rotate((frame::Rotation)orientation);
-      };
-      return yuv_rotated_func();
+      const uint16_t scaled_width = is_portrait ? out_height : out_width;
+      const uint16_t scaled_height = is_portrait ? out_width : out_height;
+      const frame::YUV yuv = yuv_func();
+      if (crop_x_offset == 0 && crop_y_offset == 0 && scaled_width == cropped_width && scaled_height == cropped_height && orientation == settings::Video::Landscape) {
+        return yuv;
+      }
+      // crop, scale and rotate in a single operation
+      return yuv.transform(crop_x_offset, crop_y_offset, cropped_width, cropped_height, out_width, out_height, (frame::Rotation)orientation);
     }};
   };
 
@@ -511,24 +508,32 @@ functional::Video<encode::Sample> transcode(const functional::Video<decode::Samp
       return include_pts(frame.pts, timescale, edit_boxes, start, duration, first_pts_and_timescale);
     }
   ).transform<frame::Frame>(
-    [&edit_boxes, timescale = video_settings.timescale, &first_pts_and_timescale, &crop_scale_rotate, in_width, in_height, in_orientation, out_width, out_height](const frame::Frame& frame) {
+    [&edit_boxes, timescale = video_settings.timescale, &first_pts_and_timescale](const frame::Frame& frame) {
       int64_t first_pts = first_pts_and_timescale.first_pts;
       CHECK(first_pts >= 0);
       int64_t scaled_first_pts = first_pts * timescale / first_pts_and_timescale.timescale;
-      return crop_scale_rotate(frame.adjust_pts(edit_boxes).shift_pts(-scaled_first_pts), in_width, in_height, in_orientation, out_width, out_height);
+      return frame.adjust_pts(edit_boxes).shift_pts(-scaled_first_pts);
     }
   );
+  auto resize = [crop_scale_rotate, in_width, in_height, in_orientation, out_width, out_height](const frame::Frame& frame) {
+    return crop_scale_rotate(frame, in_width, in_height, in_orientation, out_width, out_height);
+  };
 
   auto output_video_settings = settings::Settings<SampleType::Video>(decoder.settings().codec, out_width, out_height, video_settings.timescale, settings::Video::Landscape, decoder.settings().sps_pps);
 
+  // Decode, resize and encode run concurrently
   if (config.outfile_type == MP4 || config.outfile_type == MP2TS) {
     auto computation = encode::H264Params::ComputationalParams(config.optimization, config.encoder_threads);
     auto rc = encode::H264Params::RateControlParams(config.rc_method, config.crf, config.max_video_bitrate, config.video_bitrate, config.buffer_size, config.buffer_init, config.rc_look_ahead, config.is_second_pass, config.rc_b_mb_tree, config.aq_mode, config.qp_min, config.stats_log_path, config.mixed_refs, config.trellis, config.me_method, config.subpel_refine);
     auto gop = encode::H264Params::GopParams(config.bframes, config.pyramid_mode, config.keyint_max, config.keyint_min, config.frame_references);
     encode::H264Params params(computation, rc, gop, config.vprofile, fps);
-    return encode::H264(functional::Video<frame::Frame>(decoder, output_video_settings), params);
+    return transform::Pipeline(decoder, resize, [output_video_settings, params](const functional::Video<frame::Frame>& frames) -> functional::Video<encode::Sample> {
+      return encode::H264(functional::Video<frame::Frame>(frames, output_video_settings), params);
+    });
   } else {
-    return encode::VP8(functional::Video<frame::Frame>(decoder, output_video_settings), config.quantizer, config.optimization, fps, config.max_video_bitrate);
+    return transform::Pipeline(decoder, resize, [output_video_settings, quantizer = config.quantizer, optimization = config.optimization, fps, max_video_bitrate = config.max_video_bitrate](const functional::Video<frame::Frame>& frames) -> functional::Video<encode::Sample> {
+      return encode::VP8(functional::Video<frame::Frame>(frames, output_video_settings), quantizer, optimization, fps, max_video_bitrate);
+    });
   }
 };
 
@@ -650,6 +655,7 @@ int main(int argc, const char* argv[]) {
 
       // Create necessary encoder
       functional::Function<common::Data32> encoder;
+      std::function<void(int)> stream_encoder;  // set when the output can be written to the file as it is muxed
       if (config.outfile_type == MP4) {
         FileFormat format = FileFormat::Regular;
         if (config.dash_data) {
@@ -659,7 +665,13 @@ int main(int argc, const char* argv[]) {
         } else if (config.samples_only) {
           format = FileFormat::SamplesOnly;
         }
-        encoder = mux::MP4(output_audio_track, output_video_track, output_caption_track, format);
+        auto mp4_encoder = mux::MP4(output_audio_track, output_video_track, output_caption_track, format);
+        if (format == FileFormat::Regular) {
+          stream_encoder = [mp4_encoder](int fd) mutable {
+            mp4_encoder(fd);
+          };
+        }
+        encoder = mp4_encoder;
       } else if (config.outfile_type == MP2TS) {
         encoder = mux::MP2TS(output_audio_track, output_video_track, output_caption_track);
       } else {
@@ -669,7 +681,14 @@ int main(int argc, const char* argv[]) {
       // Start encoding and save the output file once
       const string abs_dst = common::Path::MakeAbsolute(config.outfile);
       if (i == 0) {
-        util::save(abs_dst, encoder());
+        if (stream_encoder) {
+          int fd = open(abs_dst.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+          THROW_IF(fd < 0, InvalidArguments, "Cannot open " << abs_dst);
+          stream_encoder(fd);
+          close(fd);
+        } else {
+          util::save(abs_dst, encoder());
+        }
       } else {
         encoder();
       }
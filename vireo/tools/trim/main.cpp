@@ -78,7 +78,7 @@ int main(int argc, const char* argv[]) {
     mux::MP4 mp4_encoder(audio_track, video_track, caption_track, edit_boxes);
 
     // Mux
-    util::save(output, mp4_encoder());
+    util::save(output, mp4_encoder.blocks());
   } __catch (std::exception& e) {
 #if __EXCEPTIONS
     cerr << "Error trimming movie: " << e.what() << endl;
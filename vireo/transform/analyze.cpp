@@ -0,0 +1,239 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <numeric>
+
+#include "imagecore/image/image.h"
+#include "vireo/base_cpp.h"
+#include "vireo/error/error.h"
+#include "vireo/transform/analyze.h"
+
+namespace vireo {
+namespace transform {
+
+using namespace imagecore;
+
+struct _Analyze {
+  functional::Video<frame::Frame> frames;
+  vector<Analyze::Frame> results;
+  Analyze::Stats stats;
+  bool analyzed = false;
+
+  // Halves y with imagecore's SIMD reduceHalf until it is at most kAnalyzeWidth wide (copied as is when it already is),
+  // levels are allocated for the first frame and reused as long as the dimensions do not change
+  static auto reduce(const frame::Plane& y, vector<unique_ptr<ImagePlane8>>& levels) -> ImagePlane8* {
+    auto next = [](uint32_t& width, uint32_t& height) {
+      if (width > kAnalyzeWidth && height > 1) {
+        width /= 2;
+        height /= 2;
+      }
+    };
+    uint32_t width = y.width();
+    uint32_t height = y.height();
+    next(width, height);
+    if (levels.empty() || levels.front()->getWidth() != width || levels.front()->getHeight() != height) {
+      levels.clear();
+      levels.emplace_back(ImagePlane8::create(width, height));
+      CHECK(levels.back());
+      while (width > kAnalyzeWidth && height > 1) {
+        next(width, height);
+        levels.emplace_back(ImagePlane8::create(width, height));
+        CHECK(levels.back());
+      }
+    }
+    unique_ptr<ImagePlane8> source(ImagePlane8::create((uint8_t*)y.bytes().data(), y.bytes().count()));
+    CHECK(source);
+    source->setDimensions(y.width(), y.height(), 0, y.alignment());
+    ImagePlane8* plane = source.get();
+    for (auto& level: levels) {
+      if (level->getWidth() == plane->getWidth() && level->getHeight() == plane->getHeight()) {
+        plane->copy(level.get());
+      } else {
+        plane->reduceHalf(level.get());
+      }
+      plane = level.get();
+    }
+    return plane;
+  }
+
+  // Mean standard deviation of the 8x8 blocks (of the whole plane when it is smaller than that)
+  static auto spatial(ImagePlane8* luma) -> float {
+    const uint32_t width = luma->getWidth();
+    const uint32_t height = luma->getHeight();
+    const uint8_t* bytes = luma->getBytes();
+    const uint32_t size = min(min(width, height), 8U);
+    float total = 0.0f;
+    uint32_t blocks = 0;
+    for (uint32_t by = 0; by + size <= height; by += size) {
+      for (uint32_t bx = 0; bx + size <= width; bx += size) {
+        uint32_t sum = 0;
+        uint32_t squares = 0;
+        for (uint32_t y = by; y < by + size; ++y) {
+          const uint8_t* row = bytes + y * luma->getPitch() + bx;
+          for (uint32_t x = 0; x < size; ++x) {
+            sum += row[x];
+            squares += row[x] * row[x];
+          }
+        }
+        const float n = (float)size * size;
+        const float mean = sum / n;
+        total += std::sqrt(max(squares / n - mean * mean, 0.0f));
+        ++blocks;
+      }
+    }
+    return total / blocks;
+  }
+
+  // Mean absolute difference, summed with imagecore's SIMD SAD
+  static auto temporal(ImagePlane8* luma, ImagePlane8* previous) -> float {
+    const uint64_t sad = luma->sumAbsoluteDifferences(previous);
+    return (float)sad / ((uint64_t)luma->getWidth() * luma->getHeight());
+  }
+
+  auto analyze() -> void {
+    vector<unique_ptr<ImagePlane8>> levels;
+    unique_ptr<ImagePlane8> previous;
+    std::deque<float> window;  // differences of the recent frames that are not scene cuts
+    uint32_t last_cut = 0;
+    for (uint32_t index = 0; index < frames.count(); ++index) {
+      auto start = std::chrono::steady_clock::now();
+      const frame::Frame frame = frames(index);
+      const frame::YUV yuv = frame.yuv();
+      auto fetched = std::chrono::steady_clock::now();
+      stats.fetch_time_us += std::chrono::duration_cast<std::chrono::microseconds>(fetched - start).count();
+
+      ImagePlane8* luma = reduce(yuv.plane(frame::Y), levels);
+      Analyze::Frame result = { frame.pts, spatial(luma), 0.0f, true };
+      if (index && previous->getWidth() == luma->getWidth() && previous->getHeight() == luma->getHeight()) {
+        result.temporal = temporal(luma, previous.get());
+        const float average = window.empty() ? 0.0f : std::accumulate(window.begin(), window.end(), 0.0f) / window.size();
+        result.scene_cut = result.temporal >= kAnalyzeSceneCutMinDifference &&
+                           result.temporal > kAnalyzeSceneCutRatio * average &&
+                           index - last_cut >= kAnalyzeMinSceneLength;
+      }
+      if (result.scene_cut) {
+        last_cut = index;
+      } else {
+        window.push_back(result.temporal);
+        if (window.size() > kAnalyzeSceneCutWindow) {
+          window.pop_front();
+        }
+      }
+      results.push_back(result);
+      if (!previous || previous->getWidth() != luma->getWidth() || previous->getHeight() != luma->getHeight()) {
+        previous.reset(ImagePlane8::create(luma->getWidth(), luma->getHeight()));
+        CHECK(previous);
+      }
+      luma->copy(previous.get());
+      stats.analysis_time_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - fetched).count();
+    }
+    analyzed = true;
+  }
+};
+
+Analyze::Analyze(const functional::Video<frame::Frame>& frames)
+  : _this(new _Analyze()) {
+  THROW_IF(!frames.count(), InvalidArguments);
+  _this->frames = frames;
+}
+
+Analyze::Analyze(const Analyze& analyze)
+  : _this(analyze._this) {
+}
+
+auto Analyze::frames() const -> const vector<Frame>& {
+  if (!_this->analyzed) {
+    _this->analyze();
+  }
+  return _this->results;
+}
+
+auto Analyze::stats() const -> Stats {
+  frames();
+  return _this->stats;
+}
+
+auto Analyze::scene_cuts() const -> vector<uint32_t> {
+  vector<uint32_t> cuts;
+  const auto& results = frames();
+  for (uint32_t index = 0; index < results.size(); ++index) {
+    if (results[index].scene_cut) {
+      cuts.push_back(index);
+    }
+  }
+  return cuts;
+}
+
+auto Analyze::spatial_complexity() const -> float {
+  const auto& results = frames();
+  float total = 0.0f;
+  for (const auto& result: results) {
+    total += result.spatial;
+  }
+  return total / results.size();
+}
+
+auto Analyze::temporal_complexity() const -> float {
+  float total = 0.0f;
+  uint32_t count = 0;
+  for (const auto& result: frames()) {
+    if (!result.scene_cut) {
+      total += result.temporal;
+      ++count;
+    }
+  }
+  return count ? total / count : 0.0f;
+}
+
+auto Analyze::params(const encode::H264Params& params) const -> encode::H264Params {
+  encode::H264Params recommended = params;
+  if (params.rc.rc_method == encode::RCMethod::CRF) {
+    const float offset = std::log2((spatial_complexity() + 1.0f) / (kAnalyzeReferenceSpatial + 1.0f)) +
+                         std::log2((temporal_complexity() + 1.0f) / (kAnalyzeReferenceTemporal + 1.0f));
+    const float crf = params.rc.crf + min(max(offset, -kAnalyzeMaxCRFOffset), kAnalyzeMaxCRFOffset);
+    recommended.rc.crf = min(max(crf, encode::kH264MinCRF), encode::kH264MaxCRF);
+  }
+  if (!params.gop.fixed_keyframes) {  // fixed keyframes are aligned on purpose, e.g. across renditions
+    uint32_t keyint = params.gop.keyint_max;
+    if (keyint == encode::kDefaultH264KeyintMax || !keyint) {
+      keyint = max((uint32_t)std::lround(params.fps * kAnalyzeKeyframeSeconds), (uint32_t)1);
+    }
+    recommended.gop.keyint_max = keyint;
+    recommended.gop.keyframes.clear();
+    const auto& results = frames();
+    uint32_t last = 0;
+    for (uint32_t index = 0; index < results.size(); ++index) {
+      if (!index || results[index].scene_cut || index - last >= keyint) {
+        recommended.gop.keyframes.push_back(index);
+        last = index;
+      }
+    }
+  }
+  return recommended;
+}
+
+}}
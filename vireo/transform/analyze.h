@@ -0,0 +1,76 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "vireo/base_h.h"
+#include "vireo/encode/h264.h"
+#include "vireo/frame/frame.h"
+#include "vireo/functional/media.hpp"
+
+namespace vireo {
+namespace transform {
+
+static const uint16_t kAnalyzeWidth = 160;  // luma is halved down to at most this width before it is measured
+static const float kAnalyzeSceneCutRatio = 3.0f;  // difference with the previous frame over the recent average
+static const float kAnalyzeSceneCutMinDifference = 12.0f;  // mean absolute luma difference, ignores cuts between near identical shots
+static const uint32_t kAnalyzeSceneCutWindow = 16;  // frames averaged for the recent difference
+static const uint32_t kAnalyzeMinSceneLength = 6;  // frames, flashes and fades do not cut more often than this
+static const float kAnalyzeReferenceSpatial = 10.0f;  // complexities that keep the CRF of the params as is
+static const float kAnalyzeReferenceTemporal = 4.0f;
+static const float kAnalyzeMaxCRFOffset = 3.0f;
+static const float kAnalyzeKeyframeSeconds = 5.0f;  // keyframe interval recommended when params do not have one
+
+// Content analysis of frames, measured on a downscaled luma plane in a single pass run on first access:
+// - spatial complexity: mean standard deviation of the 8x8 blocks of the frame
+// - temporal complexity: mean absolute difference with the previous frame
+// - scene cuts: frames that differ kAnalyzeSceneCutRatio times more than the recent average
+class PUBLIC Analyze final {
+  std::shared_ptr<struct _Analyze> _this = nullptr;
+public:
+  struct Frame {
+    int64_t pts;
+    float spatial;
+    float temporal;  // 0 for the first frame
+    bool scene_cut;  // the first frame is one
+  };
+  struct Stats {
+    uint64_t fetch_time_us = 0;  // time spent fetching (decoding) frames
+    uint64_t analysis_time_us = 0;  // time spent analyzing them, meant to stay under 5% of fetch_time_us
+  };
+
+  Analyze(const functional::Video<frame::Frame>& frames);
+  Analyze(const Analyze& analyze);
+  DISALLOW_ASSIGN(Analyze);
+  auto frames() const -> const vector<Frame>&;
+  auto stats() const -> Stats;  // of the pass run on first access
+  auto scene_cuts() const -> vector<uint32_t>;  // frame indices
+  auto spatial_complexity() const -> float;  // mean over all frames
+  auto temporal_complexity() const -> float;  // mean over frames that are not scene cuts
+  // params with crf moved by up to kAnalyzeMaxCRFOffset (up for busy content that masks artifacts, down for flat or still content),
+  // keyframes on scene cuts and at most keyint_max frames apart (kAnalyzeKeyframeSeconds at params.fps if not set)
+  auto params(const encode::H264Params& params) const -> encode::H264Params;
+};
+
+}}
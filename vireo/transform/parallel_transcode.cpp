@@ -0,0 +1,262 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "vireo/base_cpp.h"
+#include "vireo/common/security.h"
+#include "vireo/decode/video.h"
+#include "vireo/error/error.h"
+#include "vireo/transform/parallel_transcode.h"
+
+namespace vireo {
+namespace transform {
+
+struct _ParallelTranscode {
+  struct Segment {
+    std::thread worker;
+    bool started = false;
+    bool done = false;
+    std::shared_ptr<vector<encode::Sample>> samples;
+    std::exception_ptr error = nullptr;
+  };
+  functional::Video<decode::Sample> track;
+  ParallelTranscode::FrameTransform transform;
+  settings::Video frame_settings;
+  encode::H264Params params;
+  uint32_t thread_count;
+  vector<int64_t> sorted_pts;  // of the whole track, segments are closed so each one covers a consecutive range
+  vector<uint32_t> segments;
+  std::shared_ptr<std::mutex> track_lock = make_shared<std::mutex>();  // decoders of different segments read track one at a time
+  std::unique_ptr<functional::Video<encode::Sample>> first_encoder;  // created upfront to know the output settings, then handed over to segment 0
+  settings::Video settings;
+  std::mutex lock;
+  std::condition_variable finished;
+  vector<Segment> encoded;
+  bool delay_known = false;
+  uint32_t delay = 0;
+
+  _ParallelTranscode(const functional::Video<decode::Sample>& track, const ParallelTranscode::FrameTransform& transform, const settings::Video& frame_settings,
+                     const encode::H264Params& params, uint32_t thread_count, uint32_t segment_size)
+    : track(track), transform(transform), frame_settings(frame_settings), params(params),
+      thread_count(thread_count ? thread_count : std::max(std::thread::hardware_concurrency(), 1U)),
+      segments(Segments(track, segment_size, sorted_pts)), first_encoder(new functional::Video<encode::Sample>(encoder(0))), settings(first_encoder->settings()), encoded(segments.size()) {}
+
+  ~_ParallelTranscode() {
+    for (auto& segment: encoded) {
+      if (segment.worker.joinable()) {
+        segment.worker.join();
+      }
+    }
+  }
+
+  // Keyframes that no sample crosses in either direction in presentation order, so that segments can be decoded independently
+  static auto Segments(const functional::Video<decode::Sample>& track, uint32_t segment_size, vector<int64_t>& sorted_pts) -> vector<uint32_t> {
+    const uint32_t count = track.count();
+    vector<int64_t> pts;
+    vector<bool> keyframe;
+    pts.reserve(count);
+    keyframe.reserve(count);
+    for (const auto& sample: track) {
+      pts.push_back(sample.pts);
+      keyframe.push_back(sample.keyframe);
+    }
+    THROW_IF(!count || !keyframe[0], Invalid, "Video has to start with a keyframe");
+    vector<int64_t> min_pts_after(count + 1, numeric_limits<int64_t>::max());
+    for (uint32_t i = count; i > 0; --i) {
+      min_pts_after[i - 1] = std::min(pts[i - 1], min_pts_after[i]);
+    }
+    vector<uint32_t> segments = { 0 };
+    int64_t max_pts_before = pts[0];
+    for (uint32_t i = 1; i < count; ++i) {
+      const bool closed = keyframe[i] && max_pts_before < pts[i] && min_pts_after[i] >= pts[i];
+      if (closed && i - segments.back() >= segment_size && count - i >= segment_size) {
+        segments.push_back(i);
+      }
+      max_pts_before = std::max(max_pts_before, pts[i]);
+    }
+    sort(pts.begin(), pts.end());
+    sorted_pts = move(pts);
+    return segments;
+  }
+
+  auto segment_end(uint32_t segment) const -> uint32_t {
+    return segment + 1 < segments.size() ? segments[segment + 1] : track.count();
+  }
+
+  auto encoder(uint32_t segment) const -> functional::Video<encode::Sample> {
+    const uint32_t start = track.a() + segments[segment];
+    functional::Video<decode::Sample> segment_track([track = track, track_lock = track_lock, start](uint32_t index) -> decode::Sample {
+      std::lock_guard<std::mutex> guard(*track_lock);
+      decode::Sample sample = track(start + index);
+      const auto nal = sample.nal;
+      sample.nal = [nal, track_lock]() -> common::Data32 {
+        std::lock_guard<std::mutex> guard(*track_lock);
+        return nal();
+      };
+      return sample;
+    }, 0, segment_end(segment) - segments[segment], track.settings());
+    functional::Video<frame::Frame> frames = decode::Video(segment_track, 1);
+    if (transform) {
+      frames = frames.transform<frame::Frame>(transform);
+    }
+    return encode::H264(functional::Video<frame::Frame>(frames, frame_settings), params);
+  }
+
+  auto take_encoder(uint32_t segment) -> functional::Video<encode::Sample> {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (segment == 0 && first_encoder) {
+        const auto encoder = *first_encoder;
+        first_encoder.reset();
+        return encoder;
+      }
+    }
+    return encoder(segment);  // segment 0 transcoded again after its release also needs a new one
+  }
+
+  auto transcode(uint32_t segment) -> std::shared_ptr<vector<encode::Sample>> {
+    const auto encoder = take_encoder(segment);
+    THROW_IF(!(encoder.settings().sps_pps == settings.sps_pps), Unsupported, "Segments have to share the same SPS / PPS");
+    THROW_IF(encoder.count() != segment_end(segment) - segments[segment], Invalid);
+    auto samples = make_shared<vector<encode::Sample>>();
+    samples->reserve(encoder.count());
+    for (auto sample: encoder) {
+      samples->push_back(move(sample));
+    }
+    stitch(segment, *samples);
+    return samples;
+  }
+
+  // Each segment starts its DTS earlier than its first PTS by the number of reordered frames, so DTS is recalculated
+  // for the whole track: the sorted PTS delayed by the reordering, which has to be the same in every segment.
+  auto stitch(uint32_t segment, vector<encode::Sample>& samples) -> void {
+    CHECK(!samples.empty() && samples[0].keyframe);
+    vector<int64_t> pts;
+    pts.reserve(samples.size());
+    for (const auto& sample: samples) {
+      pts.push_back(sample.pts);
+    }
+    sort(pts.begin(), pts.end());
+    THROW_IF(!std::equal(pts.begin(), pts.end(), sorted_pts.begin() + segments[segment]), Unsupported, "Frame transform has to keep timestamps");
+    uint32_t segment_delay = 0;
+    for (const auto& sample: samples) {
+      segment_delay += (sample.dts < pts[0]);
+    }
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (!delay_known) {
+        delay = segment_delay;
+        delay_known = true;
+      }
+      THROW_IF(segment_delay != delay, Unsupported, "Segments have to share the same frame reordering");
+    }
+    const int64_t frame_duration = sorted_pts.size() > 1 ? std::max(sorted_pts[1] - sorted_pts[0], (int64_t)1) : 1;
+    for (uint32_t i = 0; i < samples.size(); ++i) {
+      const uint32_t index = segments[segment] + i;
+      samples[i].dts = (index >= delay) ? sorted_pts[index - delay] : sorted_pts[0] - (int64_t)(delay - index) * frame_duration;
+      CHECK(samples[i].dts <= samples[i].pts);
+    }
+  }
+
+  auto run(uint32_t segment) -> void {  // on the segment worker thread
+    std::shared_ptr<vector<encode::Sample>> samples;
+    std::exception_ptr error = nullptr;
+    try {
+      samples = transcode(segment);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    encoded[segment].samples = samples;
+    encoded[segment].error = error;
+    encoded[segment].done = true;
+    finished.notify_all();
+  }
+
+  auto release(uint32_t segment) -> void {  // lock has to be held, segment has to be done
+    encoded[segment].worker.join();
+    encoded[segment] = Segment();
+  }
+
+  // Segments are transcoded on demand along with the ones that follow, up to thread_count at a time,
+  // and released once reads have moved past them
+  auto samples(uint32_t segment) -> std::shared_ptr<vector<encode::Sample>> {
+    std::unique_lock<std::mutex> guard(lock);
+    const uint32_t end = (uint32_t)std::min((size_t)segment + thread_count, segments.size());
+    for (uint32_t next = segment; next < end; ++next) {
+      if (!encoded[next].started) {
+        encoded[next].started = true;
+        encoded[next].worker = std::thread(&_ParallelTranscode::run, this, next);
+      }
+    }
+    finished.wait(guard, [this, segment]() { return encoded[segment].done; });
+    const auto samples = encoded[segment].samples;
+    const auto error = encoded[segment].error;
+    for (uint32_t other = 0; other < encoded.size(); ++other) {
+      const bool kept = other + 1 >= segment && other < end;
+      if (encoded[other].done && (!kept || (other == segment && error))) {
+        release(other);
+      }
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return samples;
+  }
+};
+
+ParallelTranscode::ParallelTranscode(const functional::Video<decode::Sample>& track, const FrameTransform& transform, const settings::Video& frame_settings,
+                                     const encode::H264Params& params, uint32_t thread_count, uint32_t segment_size) {
+  THROW_IF(track.settings().codec != settings::Video::Codec::H264, Unsupported);
+  THROW_IF(track.count() >= security::kMaxSampleCount, Unsafe);
+  THROW_IF(segment_size == 0, InvalidArguments);
+  _this = make_shared<_ParallelTranscode>(track, transform, frame_settings, params, thread_count, segment_size);
+  set_bounds(0, track.count());
+  _settings = _this->settings;
+}
+
+ParallelTranscode::ParallelTranscode(const ParallelTranscode& parallel_transcode)
+  : functional::DirectVideo<ParallelTranscode, encode::Sample>(parallel_transcode.a(), parallel_transcode.b(), parallel_transcode.settings()), _this(parallel_transcode._this) {
+}
+
+auto ParallelTranscode::segments() const -> vector<uint32_t> {
+  return _this->segments;
+}
+
+auto ParallelTranscode::operator()(uint32_t index) const -> encode::Sample {
+  THROW_IF(index >= count(), OutOfRange);
+  const uint32_t segment = (uint32_t)(upper_bound(_this->segments.begin(), _this->segments.end(), index) - _this->segments.begin() - 1);
+  const auto samples = _this->samples(segment);
+  const encode::Sample& sample = (*samples)[index - _this->segments[segment]];
+  encode::Sample view(sample.pts, sample.dts, sample.keyframe, sample.type, common::Data32());
+  view.nal = common::Data32(sample.nal.data() + sample.nal.a(), sample.nal.count(), [samples](uint8_t*) {});  // keeps the segment alive instead of copying
+  return view;
+}
+
+}}
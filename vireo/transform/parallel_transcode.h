@@ -0,0 +1,61 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "vireo/base_h.h"
+#include "vireo/constants.h"
+#include "vireo/decode/types.h"
+#include "vireo/encode/h264.h"
+#include "vireo/encode/types.h"
+#include "vireo/frame/frame.h"
+#include "vireo/functional/media.hpp"
+
+namespace vireo {
+namespace transform {
+
+// Splits the video track at closed GOP boundaries into segments of at least segment_size frames, and transcodes
+// each segment with its own decoder and encode::H264 instance on a pool of thread_count workers (0: one per core).
+// Encoded segments are stitched back into a single track sharing the same SPS / PPS, with DTS recalculated across segments.
+// - transform is applied to every decoded frame and has to produce frames that match frame_settings,
+//   without a transform these are the square pixel settings of the decoded frames
+// - params are used for every segment, a low computation.thread_count (e.g. 1) is recommended as segments already run in parallel
+// - segments are transcoded on demand, together with the thread_count - 1 that follow, and released once reads have moved past them
+// - reads of track and of its sample data are serialized, decoders of different segments do not access it concurrently
+class PUBLIC ParallelTranscode final : public functional::DirectVideo<ParallelTranscode, encode::Sample> {
+  std::shared_ptr<struct _ParallelTranscode> _this = nullptr;
+public:
+  typedef std::function<frame::Frame(const frame::Frame&)> FrameTransform;
+
+  ParallelTranscode(const functional::Video<decode::Sample>& track, const encode::H264Params& params, uint32_t thread_count = 0, uint32_t segment_size = kParallelTranscodeSegmentSize)
+    : ParallelTranscode(track, nullptr, track.settings().to_square_pixel(), params, thread_count, segment_size) {}
+  ParallelTranscode(const functional::Video<decode::Sample>& track, const FrameTransform& transform, const settings::Video& frame_settings,
+                    const encode::H264Params& params, uint32_t thread_count = 0, uint32_t segment_size = kParallelTranscodeSegmentSize);
+  ParallelTranscode(const ParallelTranscode& parallel_transcode);
+  DISALLOW_ASSIGN(ParallelTranscode);
+  auto segments() const -> vector<uint32_t>;  // index of the first frame of each segment
+  auto operator()(uint32_t index) const -> encode::Sample;
+};
+
+}}
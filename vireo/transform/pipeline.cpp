@@ -0,0 +1,195 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "vireo/base_cpp.h"
+#include "vireo/error/error.h"
+#include "vireo/transform/pipeline.h"
+
+namespace vireo {
+namespace transform {
+
+// Produces the items of [a, b) in order on a worker thread, keeping at most capacity items ahead of the consumer
+template <typename T>
+class Stage final {
+  const uint32_t capacity;
+  const uint32_t a;
+  const uint32_t b;
+  const std::function<T(uint32_t)> produce;
+  std::mutex mutex;
+  std::condition_variable produced;
+  std::condition_variable consumed;
+  std::deque<T> items;
+  uint32_t first;  // index of items.front(), or of the next item to be produced when items is empty
+  bool started = false;
+  bool stopped = false;
+  std::exception_ptr error = nullptr;
+  std::thread worker;
+
+  auto run() -> void {
+    for (uint32_t index = a; index < b; ++index) {
+      try {
+        {  // wait for room before producing, so the item being produced counts towards capacity too
+          std::unique_lock<std::mutex> lock(mutex);
+          consumed.wait(lock, [this]() { return stopped || items.size() < capacity; });
+          if (stopped) {
+            return;
+          }
+        }
+        T item = produce(index);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopped) {
+          return;
+        }
+        items.push_back(move(item));
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = std::current_exception();
+        produced.notify_all();
+        return;
+      }
+      produced.notify_all();
+    }
+  }
+public:
+  Stage(uint32_t capacity, uint32_t a, uint32_t b, const std::function<T(uint32_t)>& produce)
+    : capacity(capacity), a(a), b(b), produce(produce), first(a) {}
+  Stage(const Stage&) = delete;
+  ~Stage() {
+    stop();
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  auto stop() -> void {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopped = true;
+    produced.notify_all();
+    consumed.notify_all();
+  }
+  auto operator()(uint32_t index) -> T {
+    THROW_IF(index < a || index >= b, OutOfRange);
+    std::unique_lock<std::mutex> lock(mutex);
+    THROW_IF(index < first, Unsupported);  // already released, only sequential access is supported
+    if (!started) {
+      started = true;
+      worker = std::thread(&Stage::run, this);
+    }
+    while (true) {
+      bool released = false;
+      while (!items.empty() && first < index) {  // skipping forward releases everything in between
+        items.pop_front();
+        ++first;
+        released = true;
+      }
+      if (released) {
+        consumed.notify_all();
+      }
+      if (!items.empty()) {
+        return items.front();  // kept until a later index is requested
+      }
+      if (error) {
+        std::rethrow_exception(error);
+      }
+      THROW_IF(stopped, Uninitialized);  // pipeline is being torn down
+      produced.wait(lock);
+    }
+  }
+};
+
+struct Picture {
+  int64_t pts;
+  frame::YUV yuv;
+  auto as_frame() const -> frame::Frame {
+    frame::Frame frame;
+    frame.pts = pts;
+    frame.yuv = [yuv = yuv]() -> frame::YUV {
+      return yuv;
+    };
+    frame.rgb = [yuv = yuv]() -> frame::RGB {
+      return frame::YUV(yuv).rgb(4);
+    };
+    return frame;
+  }
+};
+
+struct _Pipeline {
+  functional::Video<frame::Frame> frames;
+  Pipeline::FrameTransform transform;
+  Stage<Picture> decoded;
+  Stage<Picture> transformed;
+  functional::Video<encode::Sample> encoded;
+  Stage<encode::Sample> samples;
+
+  _Pipeline(const functional::Video<frame::Frame>& frames, const Pipeline::FrameTransform& transform, const Pipeline::Encoder& encoder, uint32_t queue_size)
+    : frames(frames), transform(transform),
+      decoded(queue_size, frames.a(), frames.b(), [this](uint32_t index) -> Picture {
+        const frame::Frame frame = this->frames(index);
+        return (Picture){ frame.pts, frame.yuv() };
+      }),
+      transformed(queue_size, frames.a(), frames.b(), [this](uint32_t index) -> Picture {
+        Picture picture = decoded(index);
+        if (!this->transform) {
+          return picture;
+        }
+        const frame::Frame frame = this->transform(picture.as_frame());
+        return (Picture){ frame.pts, frame.yuv() };
+      }),
+      encoded(encoder(functional::Video<frame::Frame>([this](uint32_t index) -> frame::Frame {
+        return transformed(index).as_frame();
+      }, frames.a(), frames.b(), frames.settings()))),
+      samples(queue_size, encoded.a(), encoded.b(), [this](uint32_t index) -> encode::Sample {
+        return this->encoded(index);
+      }) {}
+  ~_Pipeline() {
+    // unblock every worker before any of them is joined, they may be waiting on each other
+    samples.stop();
+    transformed.stop();
+    decoded.stop();
+  }
+};
+
+Pipeline::Pipeline(const functional::Video<frame::Frame>& frames, const FrameTransform& transform, const Encoder& encoder, uint32_t queue_size) {
+  THROW_IF(!encoder, InvalidArguments);
+  THROW_IF(queue_size == 0, InvalidArguments);
+  _this = make_shared<_Pipeline>(frames, transform, encoder, queue_size);
+  set_bounds(_this->encoded.a(), _this->encoded.b());
+  _settings = _this->encoded.settings();
+}
+
+Pipeline::Pipeline(const Pipeline& pipeline)
+  : functional::DirectVideo<Pipeline, encode::Sample>(pipeline.a(), pipeline.b(), pipeline.settings()), _this(pipeline._this) {
+}
+
+auto Pipeline::operator()(uint32_t index) const -> encode::Sample {
+  THROW_IF(index < a() || index >= b(), OutOfRange);
+  return _this->samples(index);
+}
+
+}}
@@ -0,0 +1,54 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "vireo/base_h.h"
+#include "vireo/constants.h"
+#include "vireo/encode/types.h"
+#include "vireo/frame/frame.h"
+#include "vireo/functional/media.hpp"
+
+namespace vireo {
+namespace transform {
+
+// Runs decode, frame transform and encode on separate threads connected with bounded queues,
+// so that the latency per frame approaches the slowest stage instead of the sum of all stages.
+// - frames are pulled in increasing order: samples are meant to be consumed sequentially (random access throws Unsupported)
+// - transform is applied to each frame independently and must not depend on other frames
+// - encoder receives the transformed frames and must pull them in increasing order (e.g. encode::H264, encode::VP8)
+class PUBLIC Pipeline final : public functional::DirectVideo<Pipeline, encode::Sample> {
+  std::shared_ptr<struct _Pipeline> _this = nullptr;
+public:
+  typedef std::function<frame::Frame(const frame::Frame&)> FrameTransform;
+  typedef std::function<functional::Video<encode::Sample>(const functional::Video<frame::Frame>&)> Encoder;
+
+  Pipeline(const functional::Video<frame::Frame>& frames, const Encoder& encoder, uint32_t queue_size = kPipelineQueueSize) : Pipeline(frames, nullptr, encoder, queue_size) {}
+  Pipeline(const functional::Video<frame::Frame>& frames, const FrameTransform& transform, const Encoder& encoder, uint32_t queue_size = kPipelineQueueSize);
+  Pipeline(const Pipeline& pipeline);
+  DISALLOW_ASSIGN(Pipeline);
+  auto operator()(uint32_t index) const -> encode::Sample;
+};
+
+}}
@@ -0,0 +1,121 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "imagecore/image/yuv.h"
+#include "vireo/base_cpp.h"
+#include "vireo/common/math.h"
+#include "vireo/common/security.h"
+#include "vireo/encode/jpg.h"
+#include "vireo/error/error.h"
+#include "vireo/frame/util.h"
+#include "vireo/transform/storyboard.h"
+
+namespace vireo {
+namespace transform {
+
+using namespace imagecore;
+
+struct _Storyboard {
+  functional::Video<frame::Frame> frames;
+  vector<uint32_t> indices;  // frame index of each tile
+  vector<Storyboard::Tile> tiles;
+  uint16_t width;
+  uint16_t height;
+  unique_ptr<frame::YUV> canvas;
+
+  auto compose() -> void {
+    for (uint32_t i = 0; i < tiles.size(); ++i) {
+      const auto& tile = tiles[i];
+      const frame::YUV yuv = frames(indices[i]).yuv();
+      THROW_IF(yuv.uv_ratio().first != 2 || yuv.uv_ratio().second != 2, Unsupported);
+      if (!canvas) {
+        canvas.reset(new frame::YUV(width, height, 2, 2, yuv.full_range()));
+      }
+      THROW_IF(yuv.full_range() != canvas->full_range(), Unsupported, "Frames have to share the same range");
+      unique_ptr<ImageYUV> src(frame::as_imagecore(yuv));
+      unique_ptr<ImageYUV> dst(frame::as_imagecore(*canvas));
+      CHECK(dst->crop(ImageRegion(tile.width, tile.height, tile.x, tile.y)));
+      CHECK(src->resize(dst.get(), kResizeQuality_High));
+    }
+  }
+};
+
+Storyboard::Storyboard(const functional::Video<frame::Frame>& frames, uint16_t columns, uint16_t rows, uint16_t tile_width)
+  : _this(new _Storyboard()) {
+  const auto& settings = frames.settings();
+  THROW_IF(!frames.count(), InvalidArguments);
+  THROW_IF(!columns || !rows, InvalidArguments);
+  THROW_IF(tile_width < 2, InvalidArguments);
+  THROW_IF(!settings.width || !settings.height, Invalid);
+  const uint16_t tile_height = std::max(common::round_divide((uint32_t)settings.height, (uint32_t)tile_width, (uint32_t)settings.width) & ~1U, 2U);
+  const uint16_t even_tile_width = tile_width & ~1;
+  THROW_IF((uint32_t)columns * even_tile_width > security::kMaxDimension || (uint32_t)rows * tile_height > security::kMaxDimension, Unsafe);
+  _this->frames = frames;
+  _this->width = columns * even_tile_width;
+  _this->height = rows * tile_height;
+
+  const uint32_t count = frames.count();
+  const uint32_t tile_count = std::min((uint32_t)columns * rows, count);
+  for (uint32_t i = 0; i < tile_count; ++i) {
+    _this->indices.push_back(frames.a() + (tile_count == 1 ? 0 : (uint32_t)common::round_divide((uint64_t)i, (uint64_t)(count - 1), (uint64_t)(tile_count - 1))));
+  }
+  const int64_t first_pts = frames(frames.a()).pts;
+  const int64_t last_pts = frames(frames.b() - 1).pts;
+  const int64_t end_pts = last_pts + (count > 1 ? (last_pts - first_pts) / (count - 1) : 0);
+  for (uint32_t i = 0; i < tile_count; ++i) {
+    const int64_t pts = frames(_this->indices[i]).pts;
+    const int64_t next_pts = i + 1 < tile_count ? frames(_this->indices[i + 1]).pts : end_pts;
+    Tile tile = { pts, (uint64_t)std::max(next_pts - pts, (int64_t)0), (uint16_t)(i % columns * even_tile_width), (uint16_t)(i / columns * tile_height), even_tile_width, tile_height };
+    _this->tiles.push_back(tile);
+  }
+}
+
+Storyboard::Storyboard(const Storyboard& storyboard) : _this(storyboard._this) {}
+
+auto Storyboard::tiles() const -> const vector<Tile>& {
+  return _this->tiles;
+}
+
+auto Storyboard::yuv() const -> frame::YUV {
+  if (!_this->canvas) {
+    _this->compose();
+  }
+  return *_this->canvas;
+}
+
+auto Storyboard::jpg(int quality, int optimization) const -> common::Data32 {
+  frame::YUV canvas = yuv();
+  vector<frame::YUV> canvases;
+  if (canvas.full_range()) {
+    canvases.push_back(canvas);
+  } else {
+    canvases.push_back(canvas.full_range(true));
+  }
+  settings::Video settings = _this->frames.settings();
+  settings.width = _this->width;
+  settings.height = _this->height;
+  return encode::JPG(functional::Video<frame::YUV>(canvases, settings), quality, optimization)(0);
+}
+
+}}
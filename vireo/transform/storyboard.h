@@ -0,0 +1,59 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Twitter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "vireo/base_h.h"
+#include "vireo/common/data.h"
+#include "vireo/frame/frame.h"
+#include "vireo/functional/media.hpp"
+
+namespace vireo {
+namespace transform {
+
+// Storyboard (sprite sheet) of columns x rows evenly spaced frames, laid out left to right then top to bottom.
+// Frames are scaled straight into their tile of a single canvas, which is then encoded once.
+// Tiles are tile_width wide and keep the aspect ratio of frames, both dimensions are rounded to even values.
+// Cells are left black when frames has fewer frames than the grid.
+class PUBLIC Storyboard final {
+  std::shared_ptr<struct _Storyboard> _this = nullptr;
+public:
+  struct Tile {
+    int64_t pts;  // in the timescale of frames
+    uint64_t duration;  // until the frame of the next tile, or the end of frames for the last tile
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+  };
+
+  Storyboard(const functional::Video<frame::Frame>& frames, uint16_t columns, uint16_t rows, uint16_t tile_width);
+  Storyboard(const Storyboard& storyboard);
+  DISALLOW_ASSIGN(Storyboard);
+  auto tiles() const -> const vector<Tile>&;
+  auto yuv() const -> frame::YUV;  // canvas, composed on first access
+  auto jpg(int quality, int optimization = 0) const -> common::Data32;  // canvas in full range through encode::JPG
+};
+
+}}
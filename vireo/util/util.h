@@ -57,4 +57,12 @@ static inline void save(const string filename, const common::Data32& data) {
   ostream.close();
 }
 
+static inline void save(const string filename, const vector<common::Data32>& blocks) {  // e.g. blocks() of a muxer, written one after the other without flattening
+  std::ofstream ostream(filename.c_str(), std::ofstream::out | std::ofstream::binary);
+  for (const auto& block: blocks) {
+    ostream << block;
+  }
+  ostream.close();
+}
+
 }}